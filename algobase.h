@@ -1,9 +1,9 @@
-// copy 算法 和 copy_backword 算法
+// copy 算法、copy_backword 算法、fill 算法和 find 算法
 
 #ifndef ALGOBASE_H
 #define ALGOBASE_H
 
-#include <iterator.h>
+#include "iterator.h"
 #include <iterator>
 #include <type_traits>
 #include <string.h>
@@ -44,7 +44,8 @@ inline OutputIterator _copy(RandomAccessIterator first, RandomAccessIterator las
 template <class T>
 inline T* _copy_t(const T* first, const T* last, T* result, std::true_type)
 {
-    memmove(result, first, sizeof(T) * (last-first));
+    if ( first != last )
+        memmove(result, first, sizeof(T) * (last-first));
     return result+(last-first);
 }
 
@@ -74,7 +75,7 @@ struct _copy_dispatch<T*, T*>
     T* operator()(T* first, T* last, T* result)
     {
 
-        return _copy_t(first,last, result, std::has_trivial_copy_assign<T>());
+        return _copy_t(first,last, result, std::is_trivially_copy_assignable<T>());
     }
 };
 
@@ -85,7 +86,7 @@ struct _copy_dispatch<const T*, T*>
     T* operator()(const T* first, const T* last, T* result)
     {
 
-        return _copy_t(first,last, result, std::has_trivial_copy_assign<T>());
+        return _copy_t(first,last, result, std::is_trivially_copy_assignable<T>());
     }
 };
 
@@ -107,8 +108,8 @@ inline char* copy(const char* first, const char* last, char* result)
 // 重载的copy 函数,为 wchar_t* 设计
 inline wchar_t* copy(const wchar_t* first, const wchar_t* last, wchar_t* result)
 {
-    return result + (last - first);
     memmove(result,first,sizeof(wchar_t) *(last-first) );
+    return result + (last - first);
 }
 
 /************************************* copy_backword ********************************/
@@ -139,7 +140,8 @@ template <class T>
 inline T* __copy_backward_t(const T* first, const T* last, T* result,
                             std::true_type) {
   const ptrdiff_t N = last - first;
-  memmove(result - N, first, sizeof(T) * N);
+  if ( N != 0 )
+    memmove(result - N, first, sizeof(T) * N);
   return result - N;
 }
 
@@ -155,7 +157,7 @@ template <class T>
 struct __copy_backward_dispatch<T*, T*>
 {
     T* operator()(T* first, T* last, T* result) {
-        return __copy_backward_t(first, last, result, std::has_trivial_copy_assign<T>() );
+        return __copy_backward_t(first, last, result, std::is_trivially_copy_assignable<T>() );
     }
 };
 
@@ -165,7 +167,7 @@ struct __copy_backward_dispatch<const T*, T*>
 {
     T* operator()(const T* first, const T* last, T* result)
     {
-        return __copy_backward_t(first, last, result, std::has_trivial_copy_assign<T>());
+        return __copy_backward_t(first, last, result, std::is_trivially_copy_assignable<T>());
     }
 };
 
@@ -180,6 +182,70 @@ inline BidirectionalIterator2 copy_backward(BidirectionalIterator1 first,
                                   BidirectionalIterator2>()(first, last,result);
 }
 
+/************************************* fill ********************************/
+
+// 把 [first, last) 的每个元素赋值为 value
+template <class ForwardIterator, class T>
+inline void fill(ForwardIterator first, ForwardIterator last, const T& value)
+{
+    for ( ; first != last; ++first )
+        *first = value;
+}
+
+// 单字节的类型直接 memset
+inline void fill(char* first, char* last, const char& value)
+{
+    if ( first != last )
+        memset(first, static_cast<unsigned char>(value), last - first);
+}
+inline void fill(unsigned char* first, unsigned char* last, const unsigned char& value)
+{
+    if ( first != last )
+        memset(first, value, last - first);
+}
+inline void fill(signed char* first, signed char* last, const signed char& value)
+{
+    if ( first != last )
+        memset(first, static_cast<unsigned char>(value), last - first);
+}
+
+// 把 first 开始的 n 个元素赋值为 value，返回最后一个元素之后的位置
+template <class OutputIterator, class Size, class T>
+inline OutputIterator fill_n(OutputIterator first, Size n, const T& value)
+{
+    for ( ; n > 0; --n, ++first )
+        *first = value;
+    return first;
+}
+
+/************************************* find ********************************/
+
+// 返回第一个等于 value 的元素，没有时返回 last
+template <class InputIterator, class T>
+inline InputIterator find(InputIterator first, InputIterator last, const T& value)
+{
+    while ( first != last && !(*first == value) )
+        ++first;
+    return first;
+}
+
+// 单字节的类型交给 memchr
+inline char* find(char* first, char* last, const char& value)
+{
+    void* p = first != last ? memchr(first, static_cast<unsigned char>(value), last - first) : nullptr;
+    return p ? static_cast<char*>(p) : last;
+}
+inline const char* find(const char* first, const char* last, const char& value)
+{
+    const void* p = first != last ? memchr(first, static_cast<unsigned char>(value), last - first) : nullptr;
+    return p ? static_cast<const char*>(p) : last;
+}
+inline unsigned char* find(unsigned char* first, unsigned char* last, const unsigned char& value)
+{
+    void* p = first != last ? memchr(first, value, last - first) : nullptr;
+    return p ? static_cast<unsigned char*>(p) : last;
+}
+
 } // namespace MySTL
 
 #endif // ALGOBASE_H
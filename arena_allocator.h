@@ -0,0 +1,220 @@
+// 这个文件定义单调增长的内存区 monotonic_arena 和建立在它之上的 arena_allocator
+// 分配只移动指针，deallocate 什么也不做，reset() 一次性释放所有对象的内存
+// 适合大量短命容器在一次请求结束后一起丢弃的场景
+
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include "construct.h"  // for construct() and destory()
+#include <cstddef>      // for size_t, max_align_t
+#include <cstdint>      // for uintptr_t
+#include <cstdlib>      // for malloc, free
+#include <new>          // for bad_alloc
+#include <climits>      // for UINT_MAX
+
+namespace MySTL{
+
+class monotonic_arena
+{
+private:
+    // 从系统取得的内存块，头部记录链表指针和大小
+    struct block{
+        block* next;
+        size_t size;
+    };
+
+    enum { DEFAULT_BLOCK_SIZE = 4096 };
+
+private:
+    char*  cur;                 // 当前内存块中下一个可用的位置
+    char*  end;                 // 当前内存块的尾部
+    block* blocks;              // 从系统取得的内存块，最新的在前
+    block* spare;               // reset() 后保留下来的最大内存块，供下次复用
+    char*  initial_buffer;      // 调用者提供的缓冲区
+    size_t initial_size;
+    size_t next_block_size;     // 下一次向系统索要的大小，按 2 倍增长
+    size_t allocated;           // 已分配出去的字节数
+
+private:
+    static char* align_up(char* p, size_t align)
+    { return reinterpret_cast<char*>( (reinterpret_cast<uintptr_t>(p) + align - 1) & ~static_cast<uintptr_t>(align - 1) ); }
+
+    // 当前内存块不够用时，换一个至少能放下 bytes 字节的内存块
+    void new_block(size_t bytes, size_t align)
+    {
+        size_t need = bytes + align + sizeof(block);
+        block* b = nullptr;
+        if ( spare != nullptr && spare->size >= need )
+        {
+            b = spare;
+            spare = nullptr;
+        }
+        else
+        {
+            size_t size = next_block_size;
+            while ( size < need )
+                size *= 2;
+            b = static_cast<block*>( std::malloc(size) );
+            if ( nullptr == b )
+                throw std::bad_alloc();
+            b->size = size;
+            next_block_size = size * 2;
+        }
+        b->next = blocks;
+        blocks = b;
+        cur = reinterpret_cast<char*>(b) + sizeof(block);
+        end = reinterpret_cast<char*>(b) + b->size;
+    }
+
+    // 释放 b 开始的所有内存块
+    static void free_blocks(block* b)
+    {
+        while ( b != nullptr )
+        {
+            block* next = b->next;
+            std::free(b);
+            b = next;
+        }
+    }
+
+public:
+    explicit monotonic_arena(size_t block_size = DEFAULT_BLOCK_SIZE)
+        : cur(nullptr), end(nullptr), blocks(nullptr), spare(nullptr),
+          initial_buffer(nullptr), initial_size(0),
+          next_block_size(block_size < sizeof(block) * 2 ? sizeof(block) * 2 : block_size), allocated(0) {}
+
+    // 先使用调用者提供的缓冲区，用完之后再向系统索要
+    monotonic_arena(void* buffer, size_t size, size_t block_size = DEFAULT_BLOCK_SIZE)
+        : monotonic_arena(block_size)
+    { use_buffer(buffer, size); }
+
+    monotonic_arena(const monotonic_arena&) = delete;
+    monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+    ~monotonic_arena() { free_blocks(blocks); free_blocks(spare); }
+
+public:
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    {
+        char* p = align_up(cur, align);
+        if ( nullptr == cur || p + bytes > end )
+        {
+            new_block(bytes, align);
+            p = align_up(cur, align);
+        }
+        cur = p + bytes;
+        allocated += bytes;
+        return p;
+    }
+
+    // 单个对象的内存无法归还，什么也不做
+    void deallocate(void*, size_t) {}
+
+    // 一次性释放所有分配出去的内存，之后从头开始使用
+    // 保留最大的一个内存块，使循环处理请求时不必反复向系统索要
+    void reset()
+    {
+        if ( blocks != nullptr )
+        {
+            block* largest = blocks;   // 按 2 倍增长，最新的就是最大的
+            free_blocks(largest->next);
+            free_blocks(spare);
+            largest->next = nullptr;
+            spare = largest;
+            blocks = nullptr;
+        }
+        if ( initial_buffer != nullptr )
+        {
+            cur = initial_buffer;
+            end = initial_buffer + initial_size;
+        }
+        else
+            cur = end = nullptr;
+        allocated = 0;
+    }
+
+    // 释放所有内存，包括保留的内存块
+    void release()
+    {
+        reset();
+        free_blocks(spare);
+        spare = nullptr;
+    }
+
+    // 改用调用者提供的缓冲区，之前分配的内存全部作废
+    void use_buffer(void* buffer, size_t size)
+    {
+        initial_buffer = static_cast<char*>(buffer);
+        initial_size = size;
+        reset();
+    }
+
+    size_t bytes_allocated() const { return allocated; }
+};
+
+// 每个 Tag 在每个线程中各有一个 arena，不同 T 的 arena_allocator 共用同一个 arena
+template <class Tag>
+struct arena_holder
+{
+    static monotonic_arena& get()
+    {
+        static thread_local monotonic_arena arena;
+        return arena;
+    }
+};
+
+// 定义 allocator 的一个公有接口，与 pool_allocator 用法相同
+// 同一个请求内的容器使用同一个 Tag，请求结束时调用 reset() 释放全部内存
+template <class T, class Tag = void>
+class arena_allocator
+{
+
+public:
+    typedef T             value_type;
+    typedef T*            pointer;
+    typedef const T*      const_pointer;
+    typedef T&            reference;
+    typedef const T&      const_reference;
+    typedef size_t        size_type;
+    typedef ptrdiff_t     ptrdiff_type;
+
+public:
+    arena_allocator() {}
+    template <class U>
+    arena_allocator(const arena_allocator<U, Tag>&) {}
+
+public:
+    static monotonic_arena& arena() { return arena_holder<Tag>::get(); }
+    static void reset() { arena().reset(); }
+
+public:
+    static T* allocate(size_t n)
+    { return 0 == n? 0 : static_cast<T*>( arena().allocate( n*sizeof(T), alignof(T) )) ; }
+    static T* allocate() { return static_cast<T*>( arena().allocate( sizeof(T), alignof(T) )); }
+    static void deallocate(T*, size_t ) {}
+    static void deallocate(T*) {}
+
+public:
+    template <class U>
+    struct rebind
+    {
+        typedef arena_allocator<U, Tag> other;
+    };
+
+public:
+    static void construct(pointer p,const T& value) { MySTL::construct(p,value); }
+    static void destory(pointer p) { MySTL::destory(p); }
+    pointer address(reference x) { return static_cast<pointer>(&x); }
+    const_pointer address(const_reference x) { return static_cast<const_pointer>(&x); }
+    size_type max_size() const { return static_cast<size_type>( UINT_MAX/sizeof(T) ); }
+
+};
+
+template <class T, class U, class Tag>
+inline bool operator==(const arena_allocator<T, Tag>&, const arena_allocator<U, Tag>&) { return true; }
+template <class T, class U, class Tag>
+inline bool operator!=(const arena_allocator<T, Tag>&, const arena_allocator<U, Tag>&) { return false; }
+
+
+} // end of namespace MySTL
+#endif // ARENA_ALLOCATOR_H
@@ -0,0 +1,395 @@
+#ifndef BIT_VECTOR_H
+#define BIT_VECTOR_H
+
+// 这个文件是 bit_vector 的头文件
+// bit_vector 每个 bool 只占一个二进制位，按 64 位的字存放在 vector 中，元素通过代理类 _bit_reference 访问
+// count、find_first/find_next、set_range/reset_range 以及向量之间的与、或、异或都按字处理，
+// 使用 popcount/ctz 指令，逐字的循环可以被编译器向量化
+// 最后一个字中超出 size() 的位始终为 0
+#include "vector.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+
+namespace MySTL {
+
+typedef uint64_t _bit_word;
+enum { __WORD_BIT = sizeof(_bit_word) * CHAR_BIT };
+
+inline size_t _bit_popcount(_bit_word x)
+{
+#if defined(__GNUC__)
+    return static_cast<size_t>( __builtin_popcountll(x) );
+#else
+    size_t n = 0;
+    for ( ; x; x &= x - 1) ++n;
+    return n;
+#endif
+}
+
+// 最低的 1 所在的位，x 不能为 0
+inline size_t _bit_ctz(_bit_word x)
+{
+#if defined(__GNUC__)
+    return static_cast<size_t>( __builtin_ctzll(x) );
+#else
+    size_t n = 0;
+    for ( ; !(x & 1); x >>= 1) ++n;
+    return n;
+#endif
+}
+
+// 低 n 位为 1 的掩码，n 小于 __WORD_BIT
+inline _bit_word _bit_low_mask(size_t n) { return (_bit_word(1) << n) - 1; }
+
+// 指向一个二进制位的代理引用
+class _bit_reference{
+public:
+    _bit_reference(_bit_word* word, _bit_word mask): _word(word), _mask(mask) {}
+
+    operator bool() const { return (*_word & _mask) != 0; }
+    _bit_reference& operator=(bool x)
+    {
+        if ( x ) *_word |= _mask;
+        else     *_word &= ~_mask;
+        return *this;
+    }
+    _bit_reference& operator=(const _bit_reference& x) { return *this = bool(x); }
+    bool operator==(const _bit_reference& x) const { return bool(*this) == bool(x); }
+    bool operator<(const _bit_reference& x) const { return !bool(*this) && bool(x); }
+    void flip() { *_word ^= _mask; }
+
+private:
+    _bit_word*  _word;
+    _bit_word   _mask;
+};
+
+inline void swap(_bit_reference x, _bit_reference y)
+{
+    bool temp = x;
+    x = y;
+    y = temp;
+}
+
+// bit_vector 的迭代器，保存字的地址和字内的位置
+template<class Ref, class WordPtr>
+class _bit_iterator{
+    template<class, class> friend class _bit_iterator;
+
+public:
+    typedef  std::random_access_iterator_tag    iterator_category;
+    typedef  bool                               value_type;
+    typedef  ptrdiff_t                          difference_type;
+    typedef  void                               pointer;
+    typedef  Ref                                reference;
+    typedef  _bit_iterator                      iterator;
+
+private:
+    WordPtr     _word;
+    size_t      _offset;    // 0 到 __WORD_BIT - 1
+
+    void bump_up() { if ( ++_offset == __WORD_BIT ){ _offset = 0; ++_word; } }
+    void bump_down() { if ( _offset-- == 0 ){ _offset = __WORD_BIT - 1; --_word; } }
+
+public:
+    _bit_iterator(): _word(nullptr), _offset(0) {}
+    _bit_iterator(WordPtr word, size_t offset): _word(word), _offset(offset) {}
+    // iterator 可以转换为 const_iterator
+    template<class R, class W>
+    _bit_iterator(const _bit_iterator<R, W>& x): _word(x._word), _offset(x._offset) {}
+
+    reference operator*() const { return reference(const_cast<_bit_word*>(_word), _bit_word(1) << _offset); }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    iterator& operator++() { bump_up(); return *this; }
+    iterator  operator++(int) { iterator temp = *this; bump_up(); return temp; }
+    iterator& operator--() { bump_down(); return *this; }
+    iterator  operator--(int) { iterator temp = *this; bump_down(); return temp; }
+    iterator& operator+=(difference_type n)
+    {
+        difference_type bits = n + static_cast<difference_type>(_offset);
+        difference_type words = bits / __WORD_BIT;
+        bits %= __WORD_BIT;
+        if ( bits < 0 ){
+            bits += __WORD_BIT;
+            --words;
+        }
+        _word += words;
+        _offset = static_cast<size_t>(bits);
+        return *this;
+    }
+    iterator& operator-=(difference_type n) { return *this += -n; }
+    iterator  operator+(difference_type n) const { iterator temp = *this; return temp += n; }
+    iterator  operator-(difference_type n) const { iterator temp = *this; return temp -= n; }
+    difference_type operator-(const iterator& x) const
+    {
+        return (_word - x._word) * __WORD_BIT
+               + static_cast<difference_type>(_offset) - static_cast<difference_type>(x._offset);
+    }
+
+    bool operator==(const iterator& x) const { return _word == x._word && _offset == x._offset; }
+    bool operator!=(const iterator& x) const { return !(*this == x); }
+    bool operator<(const iterator& x) const { return _word < x._word || (_word == x._word && _offset < x._offset); }
+    bool operator>(const iterator& x) const { return x < *this; }
+    bool operator<=(const iterator& x) const { return !(x < *this); }
+    bool operator>=(const iterator& x) const { return !(*this < x); }
+};
+
+// const_iterator 解引用得到 bool
+class _bit_const_reference{
+public:
+    _bit_const_reference(_bit_word* word, _bit_word mask): _value((*word & mask) != 0) {}
+    operator bool() const { return _value; }
+private:
+    bool _value;
+};
+
+
+template<class Alloc = pool_allocator<_bit_word> >
+class basic_bit_vector{
+
+public:
+    typedef  bool                                                       value_type;
+    typedef  _bit_reference                                             reference;
+    typedef  bool                                                       const_reference;
+    typedef  _bit_iterator<_bit_reference, _bit_word*>                  iterator;
+    typedef  _bit_iterator<_bit_const_reference, const _bit_word*>      const_iterator;
+    typedef  size_t                                                     size_type;
+    typedef  ptrdiff_t                                                  difference_type;
+    typedef  _bit_word                                                  word_type;
+    typedef  Alloc                                                      allocator_type;
+
+    // find_first/find_next 没有找到时的返回值
+    static const size_type npos = static_cast<size_type>(-1);
+
+private:
+    vector<word_type, Alloc>    _words;
+    size_type                   _size;      // 二进制位的个数
+
+private:
+    static size_type words_for(size_type bits) { return (bits + __WORD_BIT - 1) / __WORD_BIT; }
+    word_type* words() { return _words.begin(); }
+    const word_type* words() const { return _words.cbegin(); }
+
+    // 清除最后一个字中超出 size() 的位
+    void clear_tail()
+    {
+        size_type rest = _size % __WORD_BIT;
+        if ( rest )
+            words()[_size / __WORD_BIT] &= _bit_low_mask(rest);
+    }
+
+    // 从第 w 个字开始找第一个 1，mask 与第 w 个字相与
+    size_type scan(size_type w, word_type mask) const
+    {
+        const word_type* p = words();
+        size_type n = _words.size();
+        if ( w >= n )
+            return npos;
+        word_type x = p[w] & mask;
+        while ( 0 == x ){
+            if ( ++w == n )
+                return npos;
+            x = p[w];
+        }
+        return w * __WORD_BIT + _bit_ctz(x);
+    }
+
+    // 把 [first, last) 范围内的位置为 Value：首尾两个字用掩码，中间的字整字赋值
+    template<bool Value>
+    void assign_range(size_type first, size_type last)
+    {
+        if ( first >= last )
+            return;
+        word_type* p = words();
+        size_type fw = first / __WORD_BIT, lw = (last - 1) / __WORD_BIT;
+        word_type head = ~_bit_low_mask(first % __WORD_BIT);
+        word_type tail = last % __WORD_BIT ? _bit_low_mask(last % __WORD_BIT) : ~word_type(0);
+        if ( fw == lw ){
+            word_type mask = head & tail;
+            p[fw] = Value ? (p[fw] | mask) : (p[fw] & ~mask);
+            return;
+        }
+        p[fw] = Value ? (p[fw] | head) : (p[fw] & ~head);
+        for ( size_type w = fw + 1; w < lw; ++w )
+            p[w] = Value ? ~word_type(0) : word_type(0);
+        p[lw] = Value ? (p[lw] | tail) : (p[lw] & ~tail);
+    }
+
+public:
+    basic_bit_vector(): _size(0) {}
+    explicit basic_bit_vector(const Alloc& a): _words(a), _size(0) {}
+    explicit basic_bit_vector(size_type n, bool value = false, const Alloc& a = Alloc())
+        : _words(words_for(n), value ? ~word_type(0) : word_type(0), a), _size(n)
+    { clear_tail(); }
+    basic_bit_vector(std::initializer_list<bool> list, const Alloc& a = Alloc())
+        : _words(words_for(list.size()), word_type(0), a), _size(list.size())
+    {
+        size_type i = 0;
+        for ( auto item = list.begin(); item != list.end(); ++item, ++i )
+            if ( *item )
+                set(i);
+    }
+
+    allocator_type get_allocator() const { return _words.get_allocator(); }
+
+    iterator begin() { return iterator(words(), 0); }
+    iterator end() { return iterator(words() + _size / __WORD_BIT, _size % __WORD_BIT); }
+    const_iterator begin() const { return cbegin(); }
+    const_iterator end() const { return cend(); }
+    const_iterator cbegin() const { return const_iterator(words(), 0); }
+    const_iterator cend() const { return const_iterator(words() + _size / __WORD_BIT, _size % __WORD_BIT); }
+
+    size_type size() const { return _size; }
+    size_type capacity() const { return _words.capacity() * __WORD_BIT; }
+    bool empty() const { return 0 == _size; }
+
+    // 按字访问，最后一个字中超出 size() 的位为 0
+    word_type* data() { return words(); }
+    const word_type* data() const { return words(); }
+    size_type num_words() const { return _words.size(); }
+
+    reference operator[](size_type n) { return reference(words() + n / __WORD_BIT, word_type(1) << (n % __WORD_BIT)); }
+    bool operator[](size_type n) const { return test(n); }
+    bool test(size_type n) const { return (words()[n / __WORD_BIT] >> (n % __WORD_BIT)) & 1; }
+    void set(size_type n) { words()[n / __WORD_BIT] |= word_type(1) << (n % __WORD_BIT); }
+    void set(size_type n, bool value) { (*this)[n] = value; }
+    void reset(size_type n) { words()[n / __WORD_BIT] &= ~(word_type(1) << (n % __WORD_BIT)); }
+    void flip(size_type n) { words()[n / __WORD_BIT] ^= word_type(1) << (n % __WORD_BIT); }
+    reference front() { return (*this)[0]; }
+    reference back() { return (*this)[_size - 1]; }
+
+    void push_back(bool value)
+    {
+        if ( _size % __WORD_BIT == 0 )
+            _words.push_back(word_type(0));
+        if ( value )
+            set(_size);
+        ++_size;
+    }
+    void pop_back()
+    {
+        --_size;
+        reset(_size);
+        if ( _size % __WORD_BIT == 0 )
+            _words.pop_back();
+    }
+    void resize(size_type n, bool value = false)
+    {
+        size_type old_size = _size;
+        _words.resize(words_for(n), word_type(0));
+        _size = n;
+        if ( n > old_size && value )
+            assign_range<true>(old_size, n);
+        clear_tail();
+    }
+    void reserve(size_type bits) { _words.reserve(words_for(bits)); }
+    void clear() { _words.clear(); _size = 0; }
+
+    // 值为 1 的位数
+    size_type count() const
+    {
+        const word_type* p = words();
+        size_type n = _words.size(), result = 0;
+        for ( size_type w = 0; w != n; ++w )
+            result += _bit_popcount(p[w]);
+        return result;
+    }
+    bool any() const { return npos != find_first(); }
+    bool none() const { return !any(); }
+
+    // 第一个值为 1 的位，没有时返回 npos
+    size_type find_first() const { return scan(0, ~word_type(0)); }
+    // n 之后（不含 n）第一个值为 1 的位，没有时返回 npos
+    size_type find_next(size_type n) const
+    {
+        ++n;
+        if ( n >= _size )
+            return npos;
+        return scan(n / __WORD_BIT, ~_bit_low_mask(n % __WORD_BIT));
+    }
+
+    // 把 [first, last) 的位全部置 1 或清 0
+    void set_range(size_type first, size_type last) { assign_range<true>(first, last); }
+    void reset_range(size_type first, size_type last) { assign_range<false>(first, last); }
+    // 所有位取反
+    void flip()
+    {
+        word_type* p = words();
+        for ( size_type w = 0, n = _words.size(); w != n; ++w )
+            p[w] = ~p[w];
+        clear_tail();
+    }
+
+    // 逐字的位运算，x 的长度必须与 *this 相同
+    basic_bit_vector& operator&=(const basic_bit_vector& x)
+    {
+        word_type* p = words();
+        const word_type* q = x.words();
+        for ( size_type w = 0, n = _words.size(); w != n; ++w )
+            p[w] &= q[w];
+        return *this;
+    }
+    basic_bit_vector& operator|=(const basic_bit_vector& x)
+    {
+        word_type* p = words();
+        const word_type* q = x.words();
+        for ( size_type w = 0, n = _words.size(); w != n; ++w )
+            p[w] |= q[w];
+        return *this;
+    }
+    basic_bit_vector& operator^=(const basic_bit_vector& x)
+    {
+        word_type* p = words();
+        const word_type* q = x.words();
+        for ( size_type w = 0, n = _words.size(); w != n; ++w )
+            p[w] ^= q[w];
+        return *this;
+    }
+    // 清除 x 中为 1 的位
+    basic_bit_vector& subtract(const basic_bit_vector& x)
+    {
+        word_type* p = words();
+        const word_type* q = x.words();
+        for ( size_type w = 0, n = _words.size(); w != n; ++w )
+            p[w] &= ~q[w];
+        return *this;
+    }
+
+    bool operator==(const basic_bit_vector& x) const
+    {
+        if ( _size != x._size )
+            return false;
+        const word_type* p = words();
+        const word_type* q = x.words();
+        for ( size_type w = 0, n = _words.size(); w != n; ++w )
+            if ( p[w] != q[w] )
+                return false;
+        return true;
+    }
+    bool operator!=(const basic_bit_vector& x) const { return !(*this == x); }
+
+    void swap(basic_bit_vector& another)
+    {
+        _words.swap(another._words);
+        std::swap(_size, another._size);
+    }
+};
+
+template<class Alloc>
+const typename basic_bit_vector<Alloc>::size_type basic_bit_vector<Alloc>::npos;
+
+template<class Alloc>
+inline basic_bit_vector<Alloc> operator&(basic_bit_vector<Alloc> x, const basic_bit_vector<Alloc>& y) { return x &= y; }
+template<class Alloc>
+inline basic_bit_vector<Alloc> operator|(basic_bit_vector<Alloc> x, const basic_bit_vector<Alloc>& y) { return x |= y; }
+template<class Alloc>
+inline basic_bit_vector<Alloc> operator^(basic_bit_vector<Alloc> x, const basic_bit_vector<Alloc>& y) { return x ^= y; }
+
+typedef basic_bit_vector<> bit_vector;
+
+} // namespace MySTL
+
+#endif // BIT_VECTOR_H
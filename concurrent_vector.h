@@ -0,0 +1,351 @@
+#ifndef CONCURRENT_VECTOR_H
+#define CONCURRENT_VECTOR_H
+
+// 这个文件是 concurrent_vector 的头文件
+// concurrent_vector 允许多个线程同时在末尾追加元素，同时有其他线程按下标读取
+// 与 deque 一样由一段段缓冲区组成，控制中心 map 中保存每段的地址；不同的是段的大小按 2 倍增长，
+// map 的长度固定，足以覆盖整个地址空间，所以 map 和已有的段都不会重新分配，元素的地址一直有效
+// 追加时用 fetch_add 占下一段下标，所在的段不存在时分配一段并用 CAS 放入 map，不需要加锁
+// 下标占下后无法退还，分配或构造抛出异常时把这些下标记为失败，它们不含元素，clear、析构和拷贝都会跳过
+#include "pool_allocator.h"
+#include "construct.h"
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace MySTL {
+
+enum { __CV_FIRST_SHIFT = 3 };                                              // 第 0 段有 2^3 个元素
+enum { __CV_NUM_SEGMENTS = sizeof(size_t) * CHAR_BIT - __CV_FIRST_SHIFT };  // 段数，覆盖全部 size_t 下标
+
+// concurrent_vector 的迭代器，保存容器和下标，解引用时再找到所在的段
+template<class Vector, class T, class Ref, class Ptr>
+class _concurrent_vector_iterator{
+    template<class, class, class, class> friend class _concurrent_vector_iterator;
+
+public:
+    typedef  std::random_access_iterator_tag    iterator_category;
+    typedef  T                                  value_type;
+    typedef  Ptr                                pointer;
+    typedef  Ref                                reference;
+    typedef  ptrdiff_t                          difference_type;
+    typedef  size_t                             size_type;
+    typedef  _concurrent_vector_iterator        iterator;
+
+private:
+    Vector*     _vector;
+    size_type   _index;
+
+public:
+    _concurrent_vector_iterator(): _vector(nullptr), _index(0) {}
+    _concurrent_vector_iterator(Vector* v, size_type n): _vector(v), _index(n) {}
+    // iterator 可以转换为 const_iterator
+    template<class V, class P>
+    _concurrent_vector_iterator(const _concurrent_vector_iterator<V, T, T&, P>& x)
+        : _vector(x._vector), _index(x._index) {}
+
+    // 元素的下标
+    size_type index() const { return _index; }
+
+    reference operator*() const { return (*_vector)[_index]; }
+    pointer operator->() const { return &(operator*()); }
+    reference operator[](difference_type n) const { return (*_vector)[_index + n]; }
+
+    iterator& operator++() { ++_index; return *this; }
+    iterator  operator++(int) { iterator temp = *this; ++_index; return temp; }
+    iterator& operator--() { --_index; return *this; }
+    iterator  operator--(int) { iterator temp = *this; --_index; return temp; }
+    iterator& operator+=(difference_type n) { _index += n; return *this; }
+    iterator& operator-=(difference_type n) { _index -= n; return *this; }
+    iterator  operator+(difference_type n) const { return iterator(_vector, _index + n); }
+    iterator  operator-(difference_type n) const { return iterator(_vector, _index - n); }
+    difference_type operator-(const iterator& x) const
+    { return static_cast<difference_type>(_index) - static_cast<difference_type>(x._index); }
+
+    bool operator==(const iterator& x) const { return _index == x._index; }
+    bool operator!=(const iterator& x) const { return _index != x._index; }
+    bool operator<(const iterator& x) const { return _index < x._index; }
+    bool operator>(const iterator& x) const { return _index > x._index; }
+    bool operator<=(const iterator& x) const { return _index <= x._index; }
+    bool operator>=(const iterator& x) const { return _index >= x._index; }
+};
+
+
+template<class T, class Alloc = pool_allocator<T> >
+class concurrent_vector{
+
+public:
+    typedef  T              value_type;
+    typedef  T*             pointer;
+    typedef  const T*       const_pointer;
+    typedef  T&             reference;
+    typedef  const T&       const_reference;
+    typedef  size_t         size_type;
+    typedef  ptrdiff_t      difference_type;
+    typedef  Alloc          allocator_type;
+    typedef  _concurrent_vector_iterator<concurrent_vector, T, T&, T*>                      iterator;
+    typedef  _concurrent_vector_iterator<const concurrent_vector, T, const T&, const T*>    const_iterator;
+
+private:
+    // 一段构造失败、不含元素的下标 [first, last)
+    struct failed_range{
+        size_type       first;
+        size_type       last;
+        failed_range*   next;
+    };
+
+    std::atomic<pointer>    _map[ __CV_NUM_SEGMENTS ];  // 控制中心，第 k 段的地址，尚未分配时为 nullptr
+    std::atomic<size_type>  _size;                      // 已经被占用的下标个数，包括构造失败的
+    Alloc                   _alloc;
+    failed_range*           _failed;                    // 构造失败的下标，按 first 升序排列
+    std::mutex              _failed_lock;               // 只在记录失败时使用，不影响正常的追加
+
+private:
+    // 第 k 段的元素个数和第一个元素的下标
+    static size_type segment_size(size_type k) { return size_type(1) << (k + __CV_FIRST_SHIFT); }
+    static size_type segment_base(size_type k) { return segment_size(k) - segment_size(0); }
+    // 下标 n 所在的段
+    static size_type segment_index(size_type n)
+    {
+        size_type x = (n >> __CV_FIRST_SHIFT) + 1;
+#if defined(__GNUC__)
+        return sizeof(unsigned long long) * CHAR_BIT - 1 - __builtin_clzll(x);
+#else
+        size_type k = 0;
+        for ( ; x > 1; x >>= 1) ++k;
+        return k;
+#endif
+    }
+
+    // 返回第 k 段的地址，不存在时分配；多个线程同时分配时只有一个放入 map，其余的归还
+    pointer get_segment(size_type k)
+    {
+        pointer segment = _map[k].load(std::memory_order_acquire);
+        if ( segment )
+            return segment;
+        pointer fresh = _alloc.allocate(segment_size(k));
+        if ( _map[k].compare_exchange_strong(segment, fresh, std::memory_order_acq_rel, std::memory_order_acquire) )
+            return fresh;
+        _alloc.deallocate(fresh, segment_size(k));
+        return segment;
+    }
+    // 确保下标 [first, last) 所在的段都已经分配
+    void ensure_segments(size_type first, size_type last)
+    {
+        if ( first == last )
+            return;
+        for ( size_type k = segment_index(first), end = segment_index(last - 1); k <= end; ++k )
+            get_segment(k);
+    }
+    // 下标 n 的地址，所在的段必须已经分配
+    pointer slot(size_type n) const
+    {
+        size_type k = segment_index(n);
+        return _map[k].load(std::memory_order_acquire) + (n - segment_base(k));
+    }
+
+    // 记录 [first, last) 构造失败；在异常处理中调用，记录本身无法分配时只能终止
+    void mark_failed(size_type first, size_type last) noexcept
+    {
+        failed_range* range = new (std::nothrow) failed_range{ first, last, nullptr };
+        if ( nullptr == range )
+            std::terminate();
+        std::lock_guard<std::mutex> guard(_failed_lock);
+        failed_range** pos = &_failed;
+        while ( *pos != nullptr && (*pos)->first < first )
+            pos = &(*pos)->next;
+        range->next = *pos;
+        *pos = range;
+    }
+    void release_failed()
+    {
+        while ( _failed != nullptr ){
+            failed_range* next = _failed->next;
+            delete _failed;
+            _failed = next;
+        }
+    }
+    // 对每个含有元素的下标调用 f，不能与追加并发
+    template<class Function>
+    void for_each_constructed(Function f) const
+    {
+        size_type n = _size.load(std::memory_order_relaxed);
+        const failed_range* range = _failed;
+        for ( size_type i = 0; i < n; ){
+            if ( range != nullptr && i == range->first ){
+                i = range->last;
+                range = range->next;
+            }
+            else
+                f(i++);
+        }
+    }
+
+    // 占下一个下标并在那里构造元素，返回下标
+    template<class... Args>
+    size_type append(Args&&... args)
+    {
+        size_type n = _size.fetch_add(1, std::memory_order_acq_rel);
+        try{
+            size_type k = segment_index(n);
+            construct(get_segment(k) + (n - segment_base(k)), std::forward<Args>(args)...);
+        }
+        catch(...){
+            mark_failed(n, n + 1);
+            throw;
+        }
+        return n;
+    }
+
+    void init_map()
+    {
+        for ( size_type k = 0; k != __CV_NUM_SEGMENTS; ++k )
+            _map[k].store(nullptr, std::memory_order_relaxed);
+    }
+    // 析构所有元素并归还所有段
+    void release()
+    {
+        clear();
+        for ( size_type k = 0; k != __CV_NUM_SEGMENTS; ++k ){
+            pointer segment = _map[k].load(std::memory_order_relaxed);
+            if ( segment )
+                _alloc.deallocate(segment, segment_size(k));
+            _map[k].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+public:
+    concurrent_vector(): _size(0), _failed(nullptr) { init_map(); }
+    explicit concurrent_vector(const Alloc& a): _size(0), _alloc(a), _failed(nullptr) { init_map(); }
+    // 以下构造、赋值、clear 和 swap 都不能与其他操作并发
+    // 拷贝时跳过 x 中构造失败的下标，元素依次排列
+    concurrent_vector(const concurrent_vector& x): _size(0), _alloc(x._alloc), _failed(nullptr)
+    {
+        init_map();
+        try{
+            x.for_each_constructed([this, &x](size_type i) { append(x[i]); });
+        }
+        catch(...){
+            release();
+            throw;
+        }
+    }
+    concurrent_vector& operator=(const concurrent_vector& x)
+    {
+        if ( &x != this ){
+            concurrent_vector temp(x);
+            swap(temp);
+        }
+        return *this;
+    }
+    ~concurrent_vector() { release(); }
+
+public:
+    allocator_type get_allocator() const { return _alloc; }
+
+    // 已经被占用的下标个数，其中可能有其他线程正在构造的元素，以及构造失败、不含元素的下标
+    // 读者应当只访问 push_back/grow_by 返回给它、或通过其他同步得知已经构造完成的元素
+    size_type size() const { return _size.load(std::memory_order_acquire); }
+    bool empty() const { return 0 == size(); }
+    // 已分配的段能放下的元素个数
+    size_type capacity() const
+    {
+        size_type k = 0;
+        while ( k != __CV_NUM_SEGMENTS && _map[k].load(std::memory_order_acquire) )
+            ++k;
+        return segment_base(k);
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+    const_iterator begin() const { return cbegin(); }
+    const_iterator end() const { return cend(); }
+    const_iterator cbegin() const { return const_iterator(this, 0); }
+    const_iterator cend() const { return const_iterator(this, size()); }
+
+    reference operator[](size_type n) { return *slot(n); }
+    const_reference operator[](size_type n) const { return *slot(n); }
+    reference front() { return *slot(0); }
+    reference back() { return *slot(size() - 1); }
+
+    // 在末尾追加一个元素，可以与其他追加和读取并发，返回的迭代器一直有效
+    // 构造抛出异常时占下的下标记为失败，异常继续抛出
+    iterator push_back(const_reference value) { return iterator(this, append(value)); }
+    iterator push_back(value_type&& value) { return iterator(this, append(std::move(value))); }
+    template<class... Args>
+    iterator emplace_back(Args&&... args) { return iterator(this, append(std::forward<Args>(args)...)); }
+
+    // 在末尾追加 n 个 value，返回指向第一个新元素的迭代器；这 n 个元素的下标是连续的
+    // 某个元素构造失败时析构已经构造的，n 个下标都记为失败
+    iterator grow_by(size_type n, const_reference value = value_type())
+    {
+        size_type first = _size.fetch_add(n, std::memory_order_acq_rel);
+        size_type i = first;
+        try{
+            ensure_segments(first, first + n);
+            for ( ; i != first + n; ++i )
+                construct(slot(i), value);
+        }
+        catch(...){
+            for ( size_type j = first; j != i; ++j )
+                destory(slot(j));
+            mark_failed(first, first + n);
+            throw;
+        }
+        return iterator(this, first);
+    }
+    // 在末尾追加区间中的元素
+    template<class ForwardIterator, class = typename std::iterator_traits<ForwardIterator>::iterator_category>
+    iterator grow_by(ForwardIterator first, ForwardIterator last)
+    {
+        size_type n = static_cast<size_type>( std::distance(first, last) );
+        size_type start = _size.fetch_add(n, std::memory_order_acq_rel);
+        size_type i = start;
+        try{
+            ensure_segments(start, start + n);
+            for ( ; first != last; ++first, ++i )
+                construct(slot(i), *first);
+        }
+        catch(...){
+            for ( size_type j = start; j != i; ++j )
+                destory(slot(j));
+            mark_failed(start, start + n);
+            throw;
+        }
+        return iterator(this, start);
+    }
+
+    // 预先分配能放下 n 个元素的段，可以与追加并发
+    void reserve(size_type n) { ensure_segments(0, n); }
+
+    // 析构所有元素，保留已分配的段，构造失败的记录一并清除
+    void clear()
+    {
+        for_each_constructed([this](size_type i) { destory(slot(i)); });
+        release_failed();
+        _size.store(0, std::memory_order_relaxed);
+    }
+
+    void swap(concurrent_vector& another)
+    {
+        for ( size_type k = 0; k != __CV_NUM_SEGMENTS; ++k ){
+            pointer temp = _map[k].load(std::memory_order_relaxed);
+            _map[k].store(another._map[k].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            another._map[k].store(temp, std::memory_order_relaxed);
+        }
+        size_type temp = _size.load(std::memory_order_relaxed);
+        _size.store(another._size.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        another._size.store(temp, std::memory_order_relaxed);
+        std::swap(_alloc, another._alloc);
+        std::swap(_failed, another._failed);
+    }
+};
+
+} // namespace MySTL
+
+#endif // CONCURRENT_VECTOR_H
@@ -8,13 +8,15 @@
 #include <new>
 #include <type_traits>
 #include <iterator>
+#include <utility>
 
 namespace MySTL {
 
-template <class T1, class T2>
-void construct(T1* p, T2& value)
+// 在 p 处用 args 构造一个对象，参数原样转发，右值参数会调用移动构造函数
+template <class T1, class... Args>
+void construct(T1* p, Args&&... args)
 {
-    new(p) T1(value);
+    new(p) T1(std::forward<Args>(args)...);
 }
 
 // 接受一个指针的destory函数负责析构一个对象
@@ -5,32 +5,55 @@
 #include "uninitialized.h"
 #include "construct.h"
 #include <initializer_list>
+#include <iterator>
+#include <type_traits>
 
 namespace MySTL
 {
 
-// 这个函数用来计算 deque 的 buffsize
+// 每个 deque 保留的空闲缓冲区个数，队列式的使用在首尾换缓冲区时不再向分配器申请和归还
+enum { __DEQUE_SPARE_BUFFERS = 2 };
+
+// 这个函数用来计算 deque 的 buffsize，未指定 Bufsiz 时缓冲区为 512 字节
 inline size_t _deque_buf_size(size_t n, size_t sz){
     return n != 0 ? n : (sz < 512? static_cast<size_t>(512/sz) : static_cast<size_t>(1));
 }
 
+// 缓冲区为 Bytes 字节时的元素个数，用作 deque 的 Bufsiz 参数
+// 需要其他缓冲区大小时用它指定 Bufsiz（或使用下面的 page_deque），默认的 deque 布局保持不变
+template <class T, size_t Bytes>
+struct deque_buffer_bytes
+{
+    static const size_t value = sizeof(T) < Bytes ? Bytes / sizeof(T) : 1;
+};
+
 // 定义 deque 的迭代器 Bufsiz 是用户指定的缓冲区大小
-template <class T,size_t Bufsiz>
+// Ref/Ptr 为 T&/T* 时是 iterator，为 const T&/const T* 时是 const_iterator
+template <class T, class Ref, class Ptr, size_t Bufsiz>
 class _deque_iterator
 {
 public:
-    using iterator_category = std::bidirectional_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
     using value_type = T;
-    using pointer = T*;
-    using reference = T&;
+    using pointer = Ptr;
+    using reference = Ref;
     using difference_type = ptrdiff_t;
 
     using size_type = size_t;
-    using iterator = _deque_iterator; // 迭代器类型
+    using iterator = _deque_iterator<T,T&,T*,Bufsiz>;
+    using const_iterator = _deque_iterator<T,const T&,const T*,Bufsiz>;
+    using self = _deque_iterator; // 迭代器类型
+    using map_pointer_type = T**;
 
 public:
     // 默认构造函数
     _deque_iterator() = default;
+    // iterator 可以转换为 const_iterator；写成模板，不会成为 iterator 自己的拷贝构造函数
+    template <class R, class P, class = typename std::enable_if<
+                  std::is_same<_deque_iterator<T,R,P,Bufsiz>, iterator>::value
+                  && !std::is_same<self, iterator>::value>::type>
+    _deque_iterator(const _deque_iterator<T,R,P,Bufsiz>& x)
+        : first(x.first), last(x.last), cur(x.cur), map_pointer(x.map_pointer) {}
 
 public:
     // buffer_size() 返回一个缓冲区中的元素个数
@@ -40,58 +63,59 @@ public:
     }
 public:
     // 数据成员
-    pointer         first;
-    pointer         last;
-    pointer         cur;
-    pointer*        map_pointer; // 指向控制中心
+    pointer             first = nullptr;
+    pointer             last = nullptr;
+    pointer             cur = nullptr;
+    map_pointer_type    map_pointer = nullptr; // 指向控制中心
 public:
     // 设置迭代器中的 指向控制中心的指针 map_pointer,不设定cur，因为 ++/-- 中的操作不一样
-    void set_map_pointer( pointer* x )
+    void set_map_pointer( map_pointer_type x )
     {
         map_pointer = x;
         first = *x;
         last = first + buffer_size();
     }
     // 定义两个迭代器之间的减法，结果是中间的元素个数
-    difference_type operator-(const iterator & x ) const
+    template <class R, class P>
+    difference_type operator-(const _deque_iterator<T,R,P,Bufsiz>& x ) const
     {
         return (map_pointer - x.map_pointer - 1)
-                * static_cast<difference_type>(buffer_size()) + cur - first + x.last - x.cur;
+                * static_cast<difference_type>(buffer_size()) + (cur - first) + (x.last - x.cur);
     }
     // 前置加法
-    iterator& operator++()
+    self& operator++()
     {
         ++cur;
         if ( cur == last )
         {
-            set_map_pointer( ++map_pointer );
+            set_map_pointer( map_pointer + 1 );
             cur = first;
         }
         return *this;
     }
     // 后置加法
-    iterator operator++(int) { iterator temp = *this; ++*this; return temp; }
+    self operator++(int) { self temp = *this; ++*this; return temp; }
     // 前置减
-    iterator& operator--()
+    self& operator--()
     {
         if ( cur == first )
         {
-            set_map_pointer( --map_pointer );
+            set_map_pointer( map_pointer - 1 );
             cur = last;
         }
         --cur;
         return *this;
     }
     // 后置减
-    iterator operator--(int)
+    self operator--(int)
     {
-        iterator temp = *this;
+        self temp = *this;
         --*this;
         return temp;
     }
-    iterator& operator+=(difference_type n)
+    self& operator+=(difference_type n)
     {
-        difference_type offset = n + cur - first; // 相对于开头的总的偏移量
+        difference_type offset = n + (cur - first); // 相对于开头的总的偏移量
         // 如果偏移小于一个缓冲区
         if ( offset >= 0 && offset < static_cast<difference_type>( buffer_size() ) )
             cur = first + offset ;
@@ -101,32 +125,44 @@ public:
                     offset > 0? offset/static_cast<difference_type>(buffer_size())
                               :-( ( -offset -1)/static_cast<difference_type>( buffer_size() ))- 1 ;
             set_map_pointer( map_pointer + map_pointer_offset );
-            cur = first + ( offset - map_pointer_offset * buffer_size());
+            cur = first + ( offset - map_pointer_offset * static_cast<difference_type>(buffer_size()) );
         }
         return *this;
     }
-    iterator& operator-=(difference_type n)
+    self& operator-=(difference_type n)
     {
         return *this += (-n) ;
     }
-    iterator operator+(difference_type n)
+    self operator+(difference_type n) const
     {
-        iterator temp = *this;
+        self temp = *this;
         return temp += n;
     }
-    iterator operator-(difference_type n)
+    self operator-(difference_type n) const
     {
-        iterator temp = *this;
+        self temp = *this;
         return temp -= n;
     }
+    friend self operator+(difference_type n, const self& x) { return x + n; }
     // 接受语意 deque[5] = *(iterator + 5) // 为deque却做准备
-    reference operator[](difference_type n) { iterator temp = *this + n; return *temp;  }
+    reference operator[](difference_type n) const { return *(*this + n); }
     // 解引用
-    reference operator*() { return *cur; }
-    bool operator==(const iterator & x) const { return cur == x.cur; }
-    bool operator!=(const iterator & x) const { return !( operator==(x) ) ;}
-    bool operator<( const iterator & x) const
-    { return map_pointer == x.map_pointer? cur > x.cur: map_pointer < x.map_pointer;  }
+    reference operator*() const { return *cur; }
+    pointer operator->() const { return cur; }
+    // 比较只看所在的缓冲区和缓冲区内的位置，与两者的距离无关
+    template <class R, class P>
+    bool operator==(const _deque_iterator<T,R,P,Bufsiz>& x) const { return cur == x.cur; }
+    template <class R, class P>
+    bool operator!=(const _deque_iterator<T,R,P,Bufsiz>& x) const { return cur != x.cur; }
+    template <class R, class P>
+    bool operator<( const _deque_iterator<T,R,P,Bufsiz>& x) const
+    { return map_pointer == x.map_pointer? cur < x.cur: map_pointer < x.map_pointer;  }
+    template <class R, class P>
+    bool operator>( const _deque_iterator<T,R,P,Bufsiz>& x) const { return x < *this; }
+    template <class R, class P>
+    bool operator<=( const _deque_iterator<T,R,P,Bufsiz>& x) const { return !(x < *this); }
+    template <class R, class P>
+    bool operator>=( const _deque_iterator<T,R,P,Bufsiz>& x) const { return !(*this < x); }
 
 };
 
@@ -138,18 +174,14 @@ public:
     using value_type = T;
     using reference = T& ;
     using pointer = T*;
-    using const_reference = T&;
-    using const_pointer = T*;
+    using const_reference = const T&;
+    using const_pointer = const T*;
     using size_type = size_t;
     using difference_type = ptrdiff_t;
 
     // 迭代器类型
-    typedef _deque_iterator<T,Bufsiz> iterator;
-    // const迭代器还没有实现
-    //using const_iterator = iterator;
-
-
-    // using iterator = _deque_iterator<T,Bufsiz> ;
+    typedef _deque_iterator<T,T&,T*,Bufsiz> iterator;
+    typedef _deque_iterator<T,const T&,const T*,Bufsiz> const_iterator;
 
     // 下面是两个分配器
 private:
@@ -157,40 +189,48 @@ private:
     using map_pointer_allocator = typename Alloc::template rebind<pointer>::other;
     const static size_type INI_MAP_SIZE = 8;
 
+public:
+    using allocator_type = Alloc;
+
 private:
     // 数据成员
     iterator start;
     iterator finish;
     pointer* map_pointer;
     size_type map_pointer_size; // 指向的"控制中心" 有多少个可以使用的控制端口
+    data_allocator data_alloc;          // 缓冲区分配器对象
+    map_pointer_allocator map_alloc;    // 控制中心分配器对象，由 data_alloc rebind 而来
+    pointer spare[__DEQUE_SPARE_BUFFERS] = {};  // 空闲的缓冲区，换缓冲区时优先使用
+    size_type spare_count = 0;
 
 public:
     // 默认构造函数
     deque(): map_pointer_size(0),start(),finish(),map_pointer(nullptr){ fill_initialize(0,value_type());}
+    explicit deque(const Alloc& a): map_pointer_size(0),start(),finish(),map_pointer(nullptr),
+        data_alloc(a),map_alloc(a) { fill_initialize(0,value_type());}
     // 构造函数
-    deque(int n,const value_type& value): map_pointer_size(0),start(),finish(),map_pointer(nullptr)
+    deque(int n,const value_type& value, const Alloc& a = Alloc()): map_pointer_size(0),start(),finish(),
+        map_pointer(nullptr),data_alloc(a),map_alloc(a)
         { fill_initialize(n,value); }
     deque(int n): map_pointer_size(0),start(),finish(),map_pointer(nullptr)
         { fill_initialize(n,value_type()); }
-    // 拷贝构造函数
-    deque(const deque& other) noexcept
+    // 拷贝构造函数，分配器随之拷贝
+    deque(const deque& other) : data_alloc(other.data_alloc), map_alloc(other.map_alloc)
     {
           create_map_and_buffer(other.size());
-          iterator cur = start;
-          for (iterator item = other.begin(); item != other.end(); ++item )
-              data_allocator::construct((cur++).cur,*item);
+          MySTL::uninitialized_copy(other.begin(), other.end(), start);
     }
     // 接受初始值列表的构造函数
-    deque(std::initializer_list<value_type> init)
+    deque(std::initializer_list<value_type> init, const Alloc& a = Alloc()): data_alloc(a), map_alloc(a)
     {
           create_map_and_buffer( init.size() );
           iterator cur = start;
           for(auto it = init.begin(); it !=init.end(); ++it)
-              data_allocator::construct( (cur++).cur, *it);
+              data_alloc.construct( (cur++).cur, *it);
     }
     // 接受两个迭代器的构造函数
     template<class Iterator>
-    deque(Iterator begin,Iterator end)
+    deque(Iterator begin,Iterator end, const Alloc& a = Alloc()): data_alloc(a), map_alloc(a)
     {
         Iterator begin_copy = begin;
         size_type num = 0;
@@ -199,26 +239,28 @@ public:
         create_map_and_buffer( num );
         iterator cur = start;
         for (; begin != end; ++begin )
-            data_allocator::construct((cur++).cur,*begin);
+            data_alloc.construct((cur++).cur,*begin);
     }
     // 析构函数
     ~deque(){ _clear();}
     // 移动构造
-    deque(deque&& other)
+    deque(deque&& other): data_alloc(other.data_alloc), map_alloc(other.map_alloc)
     {
         start               = other.start;
         finish              = other.finish;
         map_pointer         = other.map_pointer;
         map_pointer_size    = other.map_pointer_size;
         other.map_pointer   = nullptr;
+        take_spare(other);
     }
     // 拷贝赋值
     deque& operator=(const deque& other)
     {
-        create_map_and_buffer(other.size());
-        iterator cur = start;
-        for (iterator item = other.begin(); item != other.end(); ++item )
-            data_allocator::construct((cur++).cur,*item);
+        if ( this != &other ){
+            _clear();
+            create_map_and_buffer(other.size());
+            MySTL::uninitialized_copy(other.begin(), other.end(), start);
+        }
         return *this;
     }
     // 移动赋值
@@ -229,11 +271,43 @@ public:
         finish              = other.finish;
         map_pointer         = other.map_pointer;
         map_pointer_size    = other.map_pointer_size;
+        data_alloc          = other.data_alloc;
+        map_alloc           = other.map_alloc;
         other.map_pointer   = nullptr;
+        take_spare(other);
         return *this;
     }
 
 private:
+    // 取一个缓冲区，有空闲的就不用向分配器申请
+    pointer allocate_buffer()
+    {
+        if ( spare_count != 0 )
+            return spare[--spare_count];
+        return data_alloc.allocate(buffer_size());
+    }
+    // 归还一个缓冲区，空闲的个数不超过 __DEQUE_SPARE_BUFFERS
+    void deallocate_buffer(pointer p)
+    {
+        if ( spare_count != __DEQUE_SPARE_BUFFERS )
+            spare[spare_count++] = p;
+        else
+            data_alloc.deallocate(p,buffer_size());
+    }
+    void release_spare()
+    {
+        while ( spare_count != 0 )
+            data_alloc.deallocate(spare[--spare_count],buffer_size());
+    }
+    // 接管 other 的空闲缓冲区，自己原有的先归还
+    void take_spare(deque& other)
+    {
+        release_spare();
+        for ( ; spare_count != other.spare_count; ++spare_count )
+            spare[spare_count] = other.spare[spare_count];
+        other.spare_count = 0;
+    }
+
     // 该函数用在析构函数中释放内存
     void _clear()
     {
@@ -244,30 +318,31 @@ private:
             {
                 auto item = *temp;
                 for ( size_type i = 0; i < buffer_size(); ++i)
-                    data_allocator::destory(item++);
-                data_allocator::deallocate(*temp,buffer_size());
+                    data_alloc.destory(item++);
+                data_alloc.deallocate(*temp,buffer_size());
             }
             // 释放首尾的缓冲区
             if (start.map_pointer == finish.map_pointer )
             {
                 auto p = start.cur;
                 for (; p != finish.cur; ++p )
-                   data_allocator::destory(p);
-                data_allocator::deallocate(start.first,buffer_size());
+                   data_alloc.destory(p);
+                data_alloc.deallocate(start.first,buffer_size());
             }
             else{
                 pointer p = start.cur;
                 for (; p != start.last; ++p )
-                    data_allocator::destory(p);
-                data_allocator::deallocate(start.first,buffer_size());
+                    data_alloc.destory(p);
+                data_alloc.deallocate(start.first,buffer_size());
                 p = finish.first;
                 for (; p != finish.cur; ++p )
-                    data_allocator::destory(p);
-                data_allocator::deallocate(finish.first,buffer_size());
+                    data_alloc.destory(p);
+                data_alloc.deallocate(finish.first,buffer_size());
             }
             //size_type num = finish.map_pointer - start.map_pointer + 1;
-            map_pointer_allocator::deallocate( map_pointer ,map_pointer_size);
+            map_alloc.deallocate( map_pointer ,map_pointer_size);
         }
+        release_spare();
     }
     size_type buffer_size() { return  _deque_buf_size(Bufsiz, sizeof(T)); }
     void fill_initialize(size_type n,const value_type& value)
@@ -275,20 +350,20 @@ private:
         create_map_and_buffer(n);
         pointer* cur;
         for (cur = start.map_pointer; cur < finish.map_pointer; ++cur)
-            uninitialized_fill(*cur,*cur + buffer_size(), value);
-        uninitialized_fill(finish.first, finish.cur,value);
+            MySTL::uninitialized_fill(*cur,*cur + buffer_size(), value);
+        MySTL::uninitialized_fill(finish.first, finish.cur,value);
     }
     void create_map_and_buffer(size_type num_elements)
     {
         size_type num_buffer = num_elements/buffer_size() + 1;
         map_pointer_size = std::max(static_cast<size_type>(INI_MAP_SIZE), num_buffer + 2 );
-        map_pointer = map_pointer_allocator::allocate(map_pointer_size);
+        map_pointer = map_alloc.allocate(map_pointer_size);
 
         pointer* nstart = map_pointer + (map_pointer_size - num_buffer)/2;
         pointer* nfinish = nstart + num_buffer -1;
         pointer* cur;
         for (cur = nstart; cur <= nfinish; ++cur)
-            *cur = data_allocator::allocate(buffer_size());
+            *cur = allocate_buffer();
         start.set_map_pointer(nstart);
         finish.set_map_pointer(nfinish);
         start.cur = start.first;
@@ -300,7 +375,7 @@ private:
         value_type val_copy = val;
         // 如果有必要， 则更换 map
         reserve_map_at_front();
-        *(start.map_pointer - 1) = data_allocator::allocate( buffer_size() );
+        *(start.map_pointer - 1) = allocate_buffer();
         start.set_map_pointer( --start.map_pointer);
         start.cur = start.last - 1;
         construct(start.cur,val_copy);
@@ -311,7 +386,7 @@ private:
         value_type val_copy = val;
         // 如果有需要，则更换 map
         reserve_map_at_back();
-        *(finish.map_pointer + 1) = data_allocator::allocate( buffer_size() );
+        *(finish.map_pointer + 1) = allocate_buffer();
         construct( finish.cur,val_copy );
         finish.set_map_pointer(++finish.map_pointer);
         finish.cur = finish.first;
@@ -329,16 +404,16 @@ private:
             if ( new_nstart < start.map_pointer )
                 std::copy(start.map_pointer,finish.map_pointer+1,new_nstart);
             else
-                std::copy_backward(finish.map_pointer,finish.map_pointer,new_nstart);
+                std::copy_backward(start.map_pointer,finish.map_pointer+1,new_nstart+old_num_nodes);
         }
         else // 否则重新分配 map 空间
         {
             size_type new_map_size = map_pointer_size + std::max(map_pointer_size,nodes_to_add) + 2;
-            pointer* new_map = map_pointer_allocator::allocate(new_map_size);
+            pointer* new_map = map_alloc.allocate(new_map_size);
             new_nstart = new_map + ( new_map_size - new_num_nodes)/2
                     + (add_at_front? nodes_to_add:0);
             std::copy(start.map_pointer,finish.map_pointer+1,new_nstart);
-            map_pointer_allocator::deallocate(map_pointer,map_pointer_size);
+            map_alloc.deallocate(map_pointer,map_pointer_size);
             map_pointer_size = new_map_size;
             map_pointer = new_map;
         }
@@ -362,7 +437,7 @@ private:
     value_type pop_back_aux()
     {
         value_type temp;
-        map_pointer_allocator::deallocate(finish.map_pointer,buffer_size());
+        deallocate_buffer(finish.first);
         finish.set_map_pointer( finish.map_pointer - 1 );
         finish.cur = finish.last - 1;
         temp = *finish.cur;
@@ -374,7 +449,7 @@ private:
         value_type temp;
         temp = *start.cur;
         destory(start.cur);
-        map_pointer_allocator::deallocate(start.map_pointer,buffer_size());
+        deallocate_buffer(start.first);
         start.set_map_pointer(start.map_pointer + 1);
         start.cur = start.first;
         return temp;
@@ -403,14 +478,24 @@ private:
 
 public:
     // 方法
+    allocator_type get_allocator() const { return data_alloc; }
     size_type capacity() {return map_pointer_size;}
     iterator begin() { return start;   }
     iterator end()   { return finish;  }
+    const_iterator begin() const { return start;   }
+    const_iterator end()   const { return finish;  }
+    const_iterator cbegin() const { return start;   }
+    const_iterator cend()   const { return finish;  }
     reference front() { return *start;  }
     reference back() { return *(finish - 1); }
+    const_reference front() const { return *start;  }
+    const_reference back() const { return *(finish - 1); }
     reference operator[](size_type n) { return start[ static_cast<difference_type>(n) ]; }
+    const_reference operator[](size_type n) const { return start[ static_cast<difference_type>(n) ]; }
     reference at(size_type n)
     { if (n < size()) return operator[](n); else throw std::out_of_range("out of range");}
+    const_reference at(size_type n) const
+    { if (n < size()) return operator[](n); else throw std::out_of_range("out of range");}
     size_type size() const { return finish - start; }
     bool empty() const { return start == finish; }
     void push_back(const value_type& val)
@@ -433,9 +518,9 @@ public:
     {
         value_type temp;
         if (finish.cur != finish.first){
-            temp = *(finish.cur - 1);
-            destory(finish.cur);
             --finish.cur;
+            temp = *finish.cur;
+            destory(finish.cur);
         }
         else
             temp = pop_back_aux(); // cur 在finish头
@@ -460,13 +545,13 @@ public:
         for (pointer* temp = start.map_pointer + 1; temp < finish.map_pointer; ++temp)
         {
             destory(*temp,*temp + buffer_size());
-            data_allocator::deallocate(*start.map_pointer,buffer_size());
+            deallocate_buffer(*temp);
         }
         // 如果有start和finish两个控制点，记得保留start
         if (start.map_pointer != finish.map_pointer){
             destory(start.cur,start.last);
             destory(finish.first,finish.cur);
-            data_allocator::deallocate(*finish.map_pointer,buffer_size());
+            deallocate_buffer(*finish.map_pointer);
         }
         else{
             destory(start.cur,finish.cur);
@@ -504,15 +589,15 @@ public:
                 std::copy_backward(start,first,last);
                 destory(start, new_start);
                 for ( pointer* cur = start.map_pointer;  cur < new_start.map_pointer; ++cur)
-                    data_allocator::deallocate( *cur ,buffer_size());
+                    deallocate_buffer( *cur );
                 start = new_start;
             }
             else{
                 iterator new_finish = finish - num;
                 std::copy(last,finish,first);
                 destory(new_finish,finish);
-                for (pointer* cur = finish.map_pointer; cur >= new_finish; --cur)
-                    data_allocator::deallocate(*cur,buffer_size());
+                for (pointer* cur = finish.map_pointer; cur > new_finish.map_pointer; --cur)
+                    deallocate_buffer(*cur);
                 finish = new_finish;
             }
             return start + elems_before;
@@ -537,7 +622,133 @@ public:
 
 };
 
+/*************************** 按缓冲区分段处理的算法 ***************************/
+// deque 的区间由若干段连续的缓冲区组成，下面的算法逐段交给指针版本处理，
+// 只在段的边界换缓冲区，可平凡拷贝的类型可以整段 memmove/memset
+
+// 把 [first, last) 按缓冲区拆成连续的段，依次调用 f(node, begin, end)，node 为段在 map 中的位置
+// f 返回 false 时停止，返回值表示是否处理完了所有的段
+template <class T, class Ref, class Ptr, size_t Bufsiz, class Function>
+inline bool _deque_for_each_segment(_deque_iterator<T,Ref,Ptr,Bufsiz> first, _deque_iterator<T,Ref,Ptr,Bufsiz> last,
+                                    Function f)
+{
+    if ( first.map_pointer == last.map_pointer )
+        return f(first.map_pointer, first.cur, last.cur);
+    if ( !f(first.map_pointer, first.cur, first.last) )
+        return false;
+    for ( T** node = first.map_pointer + 1; node != last.map_pointer; ++node )
+        if ( !f(node, *node, *node + _deque_iterator<T,Ref,Ptr,Bufsiz>::buffer_size()) )
+            return false;
+    return f(last.map_pointer, last.first, last.cur);
+}
+
+// 以 deque 为源的 copy，每一段按指针区间拷贝
+template <class T, class Ref, class Ptr, size_t Bufsiz, class OutputIterator>
+struct _copy_dispatch<_deque_iterator<T,Ref,Ptr,Bufsiz>, OutputIterator>
+{
+    OutputIterator operator()(_deque_iterator<T,Ref,Ptr,Bufsiz> first, _deque_iterator<T,Ref,Ptr,Bufsiz> last,
+                              OutputIterator result)
+    {
+        _deque_for_each_segment(first, last, [&result](T**, Ptr begin, Ptr end) {
+            result = MySTL::copy(begin, end, result);
+            return true;
+        });
+        return result;
+    }
+};
+
+// 以 deque 为目的的 copy，按目的缓冲区的剩余空间分段
+template <class T, size_t Bufsiz>
+inline _deque_iterator<T,T&,T*,Bufsiz> _deque_copy_into(const T* first, const T* last, _deque_iterator<T,T&,T*,Bufsiz> result)
+{
+    ptrdiff_t n = last - first;
+    while ( n > 0 )
+    {
+        ptrdiff_t room = result.last - result.cur;
+        ptrdiff_t len = n < room ? n : room;
+        MySTL::copy(first, first + len, result.cur);
+        first += len;
+        n -= len;
+        result += len;
+    }
+    return result;
+}
+
+template <class T, size_t Bufsiz>
+struct _copy_dispatch<T*, _deque_iterator<T,T&,T*,Bufsiz> >
+{
+    _deque_iterator<T,T&,T*,Bufsiz> operator()(T* first, T* last, _deque_iterator<T,T&,T*,Bufsiz> result)
+    { return _deque_copy_into<T,Bufsiz>(first, last, result); }
+};
+
+template <class T, size_t Bufsiz>
+struct _copy_dispatch<const T*, _deque_iterator<T,T&,T*,Bufsiz> >
+{
+    _deque_iterator<T,T&,T*,Bufsiz> operator()(const T* first, const T* last, _deque_iterator<T,T&,T*,Bufsiz> result)
+    { return _deque_copy_into<T,Bufsiz>(first, last, result); }
+};
+
+// 逐段赋值
+template <class T, size_t Bufsiz, class U>
+inline void fill(_deque_iterator<T,T&,T*,Bufsiz> first, _deque_iterator<T,T&,T*,Bufsiz> last, const U& value)
+{
+    _deque_for_each_segment(first, last, [&value](T**, T* begin, T* end) {
+        MySTL::fill(begin, end, static_cast<const T&>(value));
+        return true;
+    });
+}
+
+// 逐段查找，找到时由所在的段和指针构造迭代器
+template <class T, class Ref, class Ptr, size_t Bufsiz, class U>
+inline _deque_iterator<T,Ref,Ptr,Bufsiz> find(_deque_iterator<T,Ref,Ptr,Bufsiz> first,
+                                              _deque_iterator<T,Ref,Ptr,Bufsiz> last, const U& value)
+{
+    _deque_iterator<T,Ref,Ptr,Bufsiz> result = last;
+    _deque_for_each_segment(first, last, [&value, &result](T** node, Ptr begin, Ptr end) {
+        Ptr p = MySTL::find(begin, end, value);
+        if ( p == end )
+            return true;
+        result.set_map_pointer(node);
+        result.cur = p;
+        return false;
+    });
+    return result;
+}
+
+// 逐段累加，每一段是普通的指针循环
+template <class T, class Ref, class Ptr, size_t Bufsiz, class U>
+inline U accumulate(_deque_iterator<T,Ref,Ptr,Bufsiz> first, _deque_iterator<T,Ref,Ptr,Bufsiz> last, U init)
+{
+    _deque_for_each_segment(first, last, [&init](T**, Ptr begin, Ptr end) {
+        for ( ; begin != end; ++begin )
+            init = init + *begin;
+        return true;
+    });
+    return init;
+}
+
+// 逐段 uninitialized_copy，某一段抛出异常时析构前面各段已经构造的元素
+template <class T, class Ref, class Ptr, size_t Bufsiz, class ForwardIterator>
+inline ForwardIterator uninitialized_copy(_deque_iterator<T,Ref,Ptr,Bufsiz> first, _deque_iterator<T,Ref,Ptr,Bufsiz> last,
+                                          ForwardIterator result)
+{
+    ForwardIterator cur = result;
+    try{
+        _deque_for_each_segment(first, last, [&cur](T**, Ptr begin, Ptr end) {
+            cur = MySTL::uninitialized_copy(begin, end, cur);
+            return true;
+        });
+    }
+    catch(...){
+        destory(result, cur);
+        throw;
+    }
+    return cur;
+}
 
+// 缓冲区为一页（4096 字节）的 deque，适合元素较大或用作队列的场合
+template <class T, class Alloc = pool_allocator<T> >
+using page_deque = deque<T, Alloc, deque_buffer_bytes<T, 4096>::value>;
 
 
 
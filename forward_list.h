@@ -2,6 +2,7 @@
 #define FORWARD_LIST_H
 
 #include <cstddef>
+#include <iterator>
 #include "pool_allocator.h"
 #include "construct.h"
 #include <initializer_list>
@@ -63,51 +64,106 @@ public:
     using node = _forward_list_node<T>;
     // 分配器
     using data_allocator =typename Alloc::template rebind<node>::other;
+    using allocator_type = Alloc;
 
 public:
     // 数据成员
     node* node_pointer;
+    data_allocator node_alloc; // 节点分配器对象，由构造时传入的分配器 rebind 而来
 
 public:
     // 默认构造函数
     forward_list(): node_pointer(nullptr) {}
+    explicit forward_list(const Alloc& a): node_pointer(nullptr), node_alloc(a) {}
 
-    // 接受两个迭代器的构造函数
+    // 接受两个迭代器的构造函数，按原顺序建立链表
     template <class InputIterator>
-    forward_list(InputIterator first,InputIterator last):node_pointer(nullptr)
+    forward_list(InputIterator first,InputIterator last, const Alloc& a = Alloc()):node_pointer(nullptr), node_alloc(a)
     {
-        // 迫不得已，使用vector作为中介，以保证forward_list的正确顺序
-        MySTL::vector<value_type> vec(first,last);
-        auto temp = vec.end();
-        --temp;
-        for( ;temp >= vec.begin(); --temp)
-            push_front(*temp);
-        }
+        node* tail;
+        node_pointer = build_nodes(first, last, tail);
+    }
 
     // 接受 initialized_list 的构造函数
-    forward_list(const std::initializer_list<value_type>& list) : node_pointer(nullptr)
+    forward_list(const std::initializer_list<value_type>& list, const Alloc& a = Alloc())
+        : node_pointer(nullptr), node_alloc(a)
     {
-        // 迫不得已，使用vector作为中介，以保证forward_list的正确顺序
-        MySTL::vector<value_type> vec(list.begin(),list.end());
-
-        auto item = vec.end();
-        --item;
-        for (; item >= vec.begin(); --item)
-            push_front(*item);
-
+        node* tail;
+        node_pointer = build_nodes(list.begin(), list.end(), tail);
     }
 
     // 析构函数
-    ~forward_list()
+    ~forward_list() { clear(); }
+
+private:
+    // 用区间中的元素按顺序建立一段链表，返回头节点，tail 指向尾节点，区间为空时都为 nullptr
+    template <class InputIterator>
+    node* build_nodes(InputIterator first, InputIterator last, node*& tail)
     {
-        while (node_pointer != nullptr )
-            pop_front();
+        return build_nodes(first, last, tail, typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+    template <class InputIterator>
+    node* build_nodes(InputIterator first, InputIterator last, node*& tail, std::input_iterator_tag)
+    {
+        node* head = nullptr;
+        tail = nullptr;
+        for ( ; first != last; ++first )
+        {
+            node* p = create_node(*first);
+            if ( nullptr == tail )
+                head = p;
+            else
+                tail->next = p;
+            tail = p;
+        }
+        return head;
+    }
+    // 前向迭代器可以预先算出元素个数，一次批量分配所有节点
+    template <class ForwardIterator>
+    node* build_nodes(ForwardIterator first, ForwardIterator last, node*& tail, std::forward_iterator_tag)
+    {
+        size_type n = static_cast<size_type>( std::distance(first, last) );
+        node* nodes = batch_allocate(node_alloc, n);
+        node* head = nullptr;
+        tail = nullptr;
+        for ( ; first != last; ++first, --n )
+        {
+            node* p = nodes;
+            nodes = batch_next(nodes);
+            try{
+                construct(&p->data, *first);
+            }
+            catch(...){
+                // 已建立的节点和尚未使用的节点全部归还
+                while ( head != nullptr )
+                {
+                    node* next = head->next;
+                    delete_node(head);
+                    head = next;
+                }
+                batch_link(p, nodes);
+                for ( ; n != 0; --n )
+                {
+                    nodes = batch_next(p);
+                    node_alloc.deallocate(p);
+                    p = nodes;
+                }
+                throw;
+            }
+            p->next = nullptr;
+            if ( nullptr == tail )
+                head = p;
+            else
+                tail->next = p;
+            tail = p;
+        }
+        return head;
     }
 
 public:
     node* create_node(const value_type & x)
     {
-        node* p = data_allocator::allocate();
+        node* p = node_alloc.allocate();
         construct( &p->data,x);
         p->next = nullptr;
         return p;
@@ -115,9 +171,10 @@ public:
     void delete_node(node* p)
     {
         destory( &p->data );
-        data_allocator::deallocate(p);
+        node_alloc.deallocate(p);
     }
 
+    allocator_type get_allocator() const { return allocator_type(node_alloc); }
     iterator begin() { return iterator(node_pointer);}
     iterator end() { return iterator(nullptr); }
     size_type size() const
@@ -155,8 +212,33 @@ public:
         p->next = pos.node_pointer->next;
         pos.node_pointer->next = p;
     }
+    // 把区间中的元素按原顺序插入到 pos 后方
+    template <class InputIterator>
+    void insert(iterator pos, InputIterator first, InputIterator last)
+    {
+        node* tail;
+        node* head = build_nodes(first, last, tail);
+        if ( nullptr == head )
+            return;
+        tail->next = pos.node_pointer->next;
+        pos.node_pointer->next = head;
+    }
 
-    void clear() { while (node_pointer != nullptr ) pop_front(); }
+    // 节点开头就是 next 指针，整条链表可以直接一次归还给分配器
+    void clear()
+    {
+        node* first = node_pointer;
+        node* last = nullptr;
+        size_type n = 0;
+        for ( node* p = node_pointer; p != nullptr; p = p->next )
+        {
+            destory( &p->data );
+            last = p;
+            ++n;
+        }
+        batch_deallocate(node_alloc, first, last, n);
+        node_pointer = nullptr;
+    }
 
     void erase(iterator pos) {
         if (pos == begin())
@@ -177,6 +259,7 @@ public:
     // 交换两个链表的指针即可
      void swap( forward_list& f_list) {
          std::swap(node_pointer,f_list.node_pointer );
+         std::swap(node_alloc,f_list.node_alloc );
      }
 
 };
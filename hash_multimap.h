@@ -33,12 +33,15 @@ public:
 
     hasher hash_funct() const { return rep.hash_funct(); }
     key_equal key_eq() const { return rep.key_eq(); }
+    Alloc get_allocator() const { return rep.get_allocator(); }
 
 public:
     hash_multimap() :rep(100,hasher(),key_equal()) { }
     explicit hash_multimap(size_type n):rep(n,hasher(),key_equal()) {}
     hash_multimap(size_type n,const hasher& hf):rep(n,hf,key_equal()) {}
     hash_multimap(size_type n,const hasher& hf,const key_equal& eql):rep(n,hf,eql) {}
+    hash_multimap(size_type n,const hasher& hf,const key_equal& eql,const Alloc& a):rep(n,hf,eql,a) {}
+    explicit hash_multimap(const Alloc& a):rep(100,hasher(),key_equal(),a) {}
 
 public:
     Value& operator[](const key_type& key)
@@ -54,6 +57,8 @@ public:
 
 public:
     std::pair<iterator,bool> insert(const value_type& x) { return rep.insert_equal(x); }
+    template <class InputIterator>
+    void insert(InputIterator first, InputIterator last) { rep.insert_equal(first, last); }
     iterator find(const key_type& key) const { return rep.find(key); }
     size_type count(const key_type& x) { return rep.count(x);}
     void clear() {return rep.clear();}
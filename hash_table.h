@@ -71,6 +71,8 @@ public:
     using value_type = Value;
 
     using node_allocator = typename Alloc::template rebind<node>::other;
+    using bucket_allocator = typename Alloc::template rebind<node*>::other;
+    using allocator_type = Alloc;
 
     using hasher = HashFcn;
     using key_equal = EqualKey;
@@ -80,8 +82,9 @@ private:
     hasher hash;
     key_equal equals;
     ExtractKey get_key;
+    node_allocator node_alloc;  // 节点分配器对象，篮子使用由它 rebind 得到的分配器
 public:
-    vector<node*> buckets;
+    vector<node*,bucket_allocator> buckets;
     size_type num_elements; // 不用遍历就能得到元素的个数
 
 public:
@@ -102,7 +105,7 @@ public:
 
     hasher hash_funct() const { return hash; }
     key_equal key_eq() const { return equals; }
-    void empty() const  { return num_elements == 0; }
+    bool empty() const  { return num_elements == 0; }
     size_type size() const { return num_elements; }
     // 篮子个数
     size_type bucket_count() const { return buckets.size(); }
@@ -153,17 +156,29 @@ public:
         }
         return num;
     }
+    // 所有篮子的节点接成一条链表，一次归还给分配器
+    // 节点开头就是 next 指针，只需把各篮子首尾相连
     void clear()
     {
+        node* first = nullptr;
+        node* last = nullptr;
         for ( size_type i = 0; i < buckets.size(); ++i ){
             node* cur = buckets[i];
-            while ( cur != nullptr ){
-                node* tmp = cur;
-                cur = cur->next;
-                delete_node(tmp);
+            if ( cur == nullptr )
+                continue;
+            node* tail = cur;
+            for ( ; ; tail = tail->next ){
+                destory(&tail->data);
+                if ( tail->next == nullptr )
+                    break;
             }
+            tail->next = first;
+            first = cur;
+            if ( last == nullptr )
+                last = tail;
             buckets[i] = nullptr;
         }
+        batch_deallocate(node_alloc, first, last, num_elements);
         num_elements = 0;
     }
 
@@ -194,7 +209,7 @@ private:
     // 新建节点
     node* create_node(const value_type & x)
     {
-        node* p = node_allocator::allocate();
+        node* p = node_alloc.allocate();
         p->next = nullptr;
         construct( &p->data , x);
         return p;
@@ -203,7 +218,7 @@ private:
     void delete_node(node* p)
     {
         destory(&p->data);
-        node_allocator::deallocate(p);
+        node_alloc.deallocate(p);
     }
     // initialize_buckets 由构造函数调用，初始化篮子用
     void initialize_buckets(size_type n)
@@ -249,6 +264,63 @@ private:
         ++num_elements;
         return std::pair<iterator,bool>(iterator(tmp,this),true);
     }
+    template <class InputIterator>
+    void insert_range(InputIterator first, InputIterator last, bool unique, std::input_iterator_tag)
+    {
+        for ( ; first != last; ++first )
+            unique ? insert_unique(*first) : insert_equal(*first);
+    }
+    template <class ForwardIterator>
+    void insert_range(ForwardIterator first, ForwardIterator last, bool unique, std::forward_iterator_tag)
+    {
+        size_type n = static_cast<size_type>( std::distance(first, last) );
+        if ( n == 0 )
+            return;
+        resize(num_elements + n);
+        node* nodes = batch_allocate(node_alloc, n);
+        for ( ; first != last; ++first ){
+            const size_type index = bkt_num(*first);
+            node* pos = nullptr;    // 相同关键字的节点，新节点插在它后面
+            for ( node* cur = buckets[index]; cur; cur = cur->next )
+                if ( equals( get_key(cur->data), get_key(*first) ) ){
+                    pos = cur;
+                    break;
+                }
+            if ( unique && pos != nullptr )
+                continue;
+            node* tmp = nodes;
+            try{
+                construct(&tmp->data, *first);
+            }
+            catch(...){
+                return_nodes(nodes, n);
+                throw;
+            }
+            nodes = nodes->next;
+            --n;
+            if ( pos != nullptr ){
+                tmp->next = pos->next;
+                pos->next = tmp;
+            }
+            else{
+                tmp->next = buckets[index];
+                buckets[index] = tmp;
+            }
+            ++num_elements;
+        }
+        // 重复而没有用上的节点
+        return_nodes(nodes, n);
+    }
+    // 归还批量分配后剩下的 n 个未构造的节点
+    void return_nodes(node* nodes, size_type n)
+    {
+        if ( n == 0 )
+            return;
+        node* last = nodes;
+        for ( size_type i = 1; i < n; ++i )
+            last = last->next;
+        batch_deallocate(node_alloc, nodes, last, n);
+    }
 public:
     // 接受数据和篮子个数
     size_type bkt_num(const value_type& x, size_t n) const
@@ -272,10 +344,12 @@ public:
     }
 public:
     // 构造函数
-    hash_table(size_type n,const HashFcn& hf, const EqualKey& eql)
-        :hash(hf),equals(eql),get_key( ExtractKey() ),num_elements(0)
+    hash_table(size_type n,const HashFcn& hf, const EqualKey& eql, const Alloc& a = Alloc())
+        :hash(hf),equals(eql),get_key( ExtractKey() ),node_alloc(a),buckets(bucket_allocator(a)),num_elements(0)
     { initialize_buckets(n); }
 
+    allocator_type get_allocator() const { return node_alloc; }
+
     // 析构函数
     hash_table(){ clear(); }
 
@@ -291,6 +365,13 @@ public:
         resize(num_elements + 1);
         return insert_equal_aux(x);
     }
+    // 插入区间中的元素，前向迭代器先一次重建表格并批量分配节点
+    template <class InputIterator>
+    void insert_unique(InputIterator first, InputIterator last)
+    { insert_range(first, last, true, typename std::iterator_traits<InputIterator>::iterator_category()); }
+    template <class InputIterator>
+    void insert_equal(InputIterator first, InputIterator last)
+    { insert_range(first, last, false, typename std::iterator_traits<InputIterator>::iterator_category()); }
     void resize(const size_type n)
     {
         const size_type old_num = buckets.size();
@@ -298,7 +379,7 @@ public:
         if ( n > old_num ){
             const size_type new_num = next_size(n);
             if ( new_num > old_num ){
-                vector<node*> tmp( new_num, (node*) 0);
+                vector<node*,bucket_allocator> tmp( new_num, (node*) 0, buckets.get_allocator() );
 
                 for(size_type bucket = 0; bucket < old_num; ++bucket)
                 {
@@ -0,0 +1,432 @@
+// 这个文件定义按分配字节数采样的堆分析器 heap_profiler
+// 开启后平均每分配 sample_bytes 字节记录一次调用栈和容器的节点类型，对象释放时删除记录
+// 仍存活的采样可以输出为 pprof 的 heap profile 文本格式，或按类型汇总的文本
+// 关闭时 alloc 的快速路径上只多一次 relaxed 读；采样稀疏时开销很小，可以在线上常开
+
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+
+#include <cstddef>      // for size_t
+#include <cstdarg>      // for va_list
+#include <cstdint>      // for uint64_t, int64_t, uintptr_t
+#include <cstdio>       // for snprintf
+#include <cstring>      // for strstr, strlen
+#include <cmath>        // for log, exp
+#include <atomic>       // for atomic
+#include <mutex>        // for once_flag, mutex
+#include <vector>       // for std::vector, 只在输出时使用
+#include <algorithm>    // for std::sort
+#include <execinfo.h>   // for backtrace
+#include <fcntl.h>      // for open
+#include <sys/mman.h>   // for mmap
+#include <unistd.h>     // for write, read
+
+namespace MySTL{
+
+// 返回描述类型 T 的字符串，不依赖 RTTI，输出时从中取出 T 的名字
+template <class T>
+inline const char* heap_type_name() { return __PRETTY_FUNCTION__; }
+
+class heap_profiler
+{
+private:
+    enum { MAX_DEPTH = 32 };    // 记录的调用栈最大深度
+
+    // 一条采样记录，ptr 为 EMPTY 表示空位
+    struct sample{
+        std::atomic<uintptr_t> ptr;
+        size_t      size;
+        const char* type;
+        int         depth;
+        void*       stack[ MAX_DEPTH ];
+    };
+
+    enum : uintptr_t { EMPTY = 0 };
+
+    // 按对象地址线性探测的表，分配后不再释放
+    // 删除时把后面的记录前移填补空位，不留墓碑，查找的长度只取决于当前的装载率
+    // 插入、删除和输出在 table_lock 下进行；释放对象时的查找不加锁，
+    // 用 version 判断查找期间是否有记录被移动（奇数表示正在移动），有则重试
+    static sample* table;
+    static size_t  capacity;
+    static std::atomic<bool>   table_ready;
+    static std::mutex          table_lock;
+    static std::atomic<size_t> version;
+
+    static std::atomic<size_t> sample_interval;     // 平均采样间隔（字节），0 表示关闭
+    static std::atomic<long>   live_samples;        // 表中存活的记录数
+    static std::atomic<uint64_t> dropped_samples;   // 表满而丢弃的采样数
+
+    static thread_local int64_t  bytes_until_sample;
+    static thread_local uint64_t rng_state;
+
+private:
+    static size_t hash(uintptr_t p) { return static_cast<size_t>( (p >> 4) * 0x9E3779B97F4A7C15ull ); }
+
+    // 下一次采样前要分配的字节数，服从均值为 sample_interval 的指数分布，以免与分配模式同步
+    static int64_t next_sample_distance(size_t interval)
+    {
+        if ( 0 == rng_state )
+            rng_state = reinterpret_cast<uintptr_t>(&rng_state) | 1;
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 7;
+        rng_state ^= rng_state << 17;
+        double u = ( (rng_state >> 11) + 1.0 ) / 9007199254740993.0;   // (0, 1]
+        return static_cast<int64_t>( -std::log(u) * static_cast<double>(interval) ) + 1;
+    }
+
+    static void record(void* p, size_t n, const char* type);
+    static void remove(void* p);
+    // 在 table_lock 下删除 key 的记录并前移后面的记录
+    static void erase_locked(uintptr_t key);
+
+public:
+    // 开始采样，平均每分配 sample_bytes 字节采样一次；capacity 为最多同时保存的采样数，只在第一次调用时生效
+    static void start(size_t sample_bytes = 512 * 1024, size_t max_samples = 16384);
+    // 停止采样，已有的记录仍保留，对象释放时照常删除
+    static void stop() { sample_interval.store(0, std::memory_order_relaxed); }
+    static bool enabled() { return sample_interval.load(std::memory_order_relaxed) != 0; }
+
+    // 在 alloc 中调用：分配了 n 字节的 p 后，按需要记录一次采样
+    static void on_allocate(void* p, size_t n, const char* type)
+    {
+        size_t interval = sample_interval.load(std::memory_order_relaxed);
+        if ( 0 == interval )
+            return;
+        bytes_until_sample -= static_cast<int64_t>(n);
+        if ( bytes_until_sample >= 0 )
+            return;
+        // 线程第一次到这里时还没有抽取过采样距离
+        if ( 0 == rng_state )
+        {
+            bytes_until_sample = next_sample_distance(interval) - static_cast<int64_t>(n);
+            if ( bytes_until_sample >= 0 )
+                return;
+        }
+        bytes_until_sample = next_sample_distance(interval);
+        record(p, n, type);
+    }
+    // 在 alloc 中调用：释放 p 之前删除它的记录
+    static void on_deallocate(void* p)
+    {
+        if ( live_samples.load(std::memory_order_relaxed) != 0 )
+            remove(p);
+    }
+    // 表中有存活记录时才需要对释放的对象逐个调用 on_deallocate
+    static bool has_samples() { return live_samples.load(std::memory_order_relaxed) != 0; }
+
+    // 以 pprof 的 heap profile 文本格式（heap_v2）输出存活的采样，可用 pprof <binary> <file> 查看
+    static void dump_pprof(int fd);
+    // 按类型和调用栈汇总输出存活的采样，字节数按采样率换算为估计值
+    static void dump_text(int fd);
+};
+
+heap_profiler::sample* heap_profiler::table = nullptr;
+size_t heap_profiler::capacity = 0;
+std::atomic<bool> heap_profiler::table_ready( false );
+std::mutex heap_profiler::table_lock;
+std::atomic<size_t> heap_profiler::version( 0 );
+std::atomic<size_t> heap_profiler::sample_interval( 0 );
+std::atomic<long> heap_profiler::live_samples( 0 );
+std::atomic<uint64_t> heap_profiler::dropped_samples( 0 );
+thread_local int64_t heap_profiler::bytes_until_sample = 0;
+thread_local uint64_t heap_profiler::rng_state = 0;
+
+void heap_profiler::start(size_t sample_bytes, size_t max_samples)
+{
+    static std::once_flag created;
+    std::call_once(created, [max_samples]{
+        // 容量取 2 的幂，并留出一半空位，使探测序列保持很短
+        size_t n = 1;
+        while ( n < max_samples * 2 )
+            n <<= 1;
+        void* p = mmap(nullptr, n * sizeof(sample), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ( MAP_FAILED == p )
+            return;
+        table = static_cast<sample*>(p);    // mmap 的内存全为 0，即所有位置都是 EMPTY
+        capacity = n;
+        table_ready.store(true, std::memory_order_release);
+    });
+    if ( table_ready.load(std::memory_order_acquire) )
+        sample_interval.store(sample_bytes == 0 ? 1 : sample_bytes, std::memory_order_relaxed);
+}
+
+void heap_profiler::record(void* p, size_t n, const char* type)
+{
+    if ( nullptr == p )
+        return;
+    // 调用栈在加锁之前取得
+    void* stack[ MAX_DEPTH ];
+    int depth = backtrace(stack, MAX_DEPTH);
+
+    std::lock_guard<std::mutex> guard(table_lock);
+    // 表只保留一半空位，超过就丢弃，使探测序列保持很短
+    if ( static_cast<size_t>( live_samples.load(std::memory_order_relaxed) ) >= capacity / 2 )
+    {
+        dropped_samples.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // 插入不移动已有的记录，不需要修改 version
+    size_t mask = capacity - 1;
+    size_t i = hash(reinterpret_cast<uintptr_t>(p));
+    while ( table[i & mask].ptr.load(std::memory_order_relaxed) != EMPTY )
+        ++i;
+    sample& s = table[i & mask];
+    s.size = n;
+    s.type = type;
+    s.depth = depth;
+    std::copy(stack, stack + depth, s.stack);
+    s.ptr.store(reinterpret_cast<uintptr_t>(p), std::memory_order_release);
+    live_samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void heap_profiler::erase_locked(uintptr_t key)
+{
+    size_t mask = capacity - 1;
+    size_t i = hash(key) & mask;
+    for ( ; ; i = (i + 1) & mask )
+    {
+        uintptr_t cur = table[i].ptr.load(std::memory_order_relaxed);
+        if ( EMPTY == cur )
+            return;
+        if ( cur == key )
+            break;
+    }
+
+    size_t v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    // i 是空位；后面的记录若其初始位置不在 (i, j] 中，就前移到 i，j 成为新的空位
+    for ( size_t j = (i + 1) & mask; ; j = (j + 1) & mask )
+    {
+        uintptr_t cur = table[j].ptr.load(std::memory_order_relaxed);
+        if ( EMPTY == cur )
+            break;
+        size_t home = hash(cur) & mask;
+        if ( ((j - home) & mask) >= ((j - i) & mask) )
+        {
+            sample& from = table[j];
+            sample& to = table[i];
+            to.size = from.size;
+            to.type = from.type;
+            to.depth = from.depth;
+            std::copy(from.stack, from.stack + from.depth, to.stack);
+            to.ptr.store(cur, std::memory_order_relaxed);
+            i = j;
+        }
+    }
+    table[i].ptr.store(EMPTY, std::memory_order_relaxed);
+    version.store(v + 2, std::memory_order_release);
+    live_samples.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void heap_profiler::remove(void* p)
+{
+    uintptr_t key = reinterpret_cast<uintptr_t>(p);
+    size_t mask = capacity - 1;
+    for ( ; ; )
+    {
+        size_t v = version.load(std::memory_order_acquire);
+        bool found = false;
+        if ( 0 == (v & 1) )
+        {
+            for ( size_t i = hash(key); ; ++i )
+            {
+                uintptr_t cur = table[i & mask].ptr.load(std::memory_order_relaxed);
+                if ( EMPTY == cur )
+                    break;
+                if ( cur == key ){
+                    found = true;
+                    break;
+                }
+            }
+            if ( !found )
+            {
+                // 查找期间没有记录被移动，空位处结束的探测说明 p 没有被采样，这是最常见的情况
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if ( version.load(std::memory_order_relaxed) == v )
+                    return;
+                continue;
+            }
+        }
+        std::lock_guard<std::mutex> guard(table_lock);
+        erase_locked(key);
+        return;
+    }
+}
+
+namespace heap_profiler_detail{
+
+// 输出时使用的缓冲区，满了就 write 到 fd
+struct writer{
+    int fd;
+    char buf[4096];
+    size_t len;
+
+    void flush() { if ( len != 0 && ::write(fd, buf, len) < 0 ) {} len = 0; }
+    void put(const char* str, size_t n)
+    {
+        for ( size_t i = 0; i != n; ++i )
+        {
+            if ( len == sizeof(buf) )
+                flush();
+            buf[len++] = str[i];
+        }
+    }
+    writer& operator<<(const char* str) { put(str, std::strlen(str)); return *this; }
+    writer& printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char tmp[512];
+        va_list args;
+        va_start(args, fmt);
+        int n = std::vsnprintf(tmp, sizeof(tmp), fmt, args);
+        va_end(args);
+        if ( n > 0 )
+            put(tmp, static_cast<size_t>(n) < sizeof(tmp) ? n : sizeof(tmp) - 1);
+        return *this;
+    }
+};
+
+// 按类型和调用栈汇总的一组采样
+struct bucket{
+    const char* type;
+    int         depth;
+    void* const* stack;
+    uint64_t    count;
+    uint64_t    bytes;
+    double      estimated;
+};
+
+// 从 heap_type_name<T>() 的结果中取出 T 的名字，写到 out
+inline void print_type(writer& out, const char* name)
+{
+    if ( nullptr == name )
+    {
+        out << "(untyped)";
+        return;
+    }
+    const char* begin = std::strstr(name, "T = ");
+    if ( nullptr == begin )
+    {
+        out << name;
+        return;
+    }
+    begin += 4;
+    size_t n = std::strlen(begin);
+    // GCC 的格式以 "]" 结尾，也可能带有 "; ..." 的附加说明
+    const char* semi = std::strchr(begin, ';');
+    if ( semi != nullptr )
+        n = semi - begin;
+    else if ( n != 0 && begin[n - 1] == ']' )
+        --n;
+    out.put(begin, n);
+}
+
+} // namespace heap_profiler_detail
+
+void heap_profiler::dump_pprof(int fd)
+{
+    using namespace heap_profiler_detail;
+    std::lock_guard<std::mutex> guard(table_lock);
+    writer out{ fd, {}, 0 };
+    size_t interval = sample_interval.load(std::memory_order_relaxed);
+
+    // 按调用栈汇总
+    std::vector<bucket> buckets;
+    uint64_t total_count = 0, total_bytes = 0;
+    for ( size_t i = 0; i != capacity; ++i )
+    {
+        const sample& s = table[i];
+        if ( EMPTY == s.ptr.load(std::memory_order_relaxed) )
+            continue;
+        bool merged = false;
+        for ( bucket& b : buckets )
+            if ( b.depth == s.depth && std::equal(s.stack, s.stack + s.depth, b.stack) )
+            {
+                ++b.count;
+                b.bytes += s.size;
+                merged = true;
+                break;
+            }
+        if ( !merged )
+            buckets.push_back( bucket{ s.type, s.depth, s.stack, 1, s.size, 0 } );
+        ++total_count;
+        total_bytes += s.size;
+    }
+
+    out.printf("heap profile: %llu: %llu [ %llu: %llu] @ heap_v2/%zu\n",
+               (unsigned long long)total_count, (unsigned long long)total_bytes,
+               (unsigned long long)total_count, (unsigned long long)total_bytes, interval == 0 ? size_t(1) : interval);
+    for ( const bucket& b : buckets )
+    {
+        out.printf("%llu: %llu [%llu: %llu] @", (unsigned long long)b.count, (unsigned long long)b.bytes,
+                   (unsigned long long)b.count, (unsigned long long)b.bytes);
+        for ( int i = 0; i != b.depth; ++i )
+            out.printf(" %p", b.stack[i]);
+        out << "\n";
+    }
+
+    // pprof 用内存映射表把地址对应到可执行文件和动态库
+    out << "\nMAPPED_LIBRARIES:\n";
+    int maps = ::open("/proc/self/maps", O_RDONLY);
+    if ( maps >= 0 )
+    {
+        char buf[4096];
+        ssize_t n;
+        while ( (n = ::read(maps, buf, sizeof(buf))) > 0 )
+            out.put(buf, static_cast<size_t>(n));
+        ::close(maps);
+    }
+    out.flush();
+}
+
+void heap_profiler::dump_text(int fd)
+{
+    using namespace heap_profiler_detail;
+    std::lock_guard<std::mutex> guard(table_lock);
+    writer out{ fd, {}, 0 };
+    size_t interval = sample_interval.load(std::memory_order_relaxed);
+
+    // 按类型和调用栈汇总，每个采样代表的字节数按 size / (1 - exp(-size / interval)) 估计
+    std::vector<bucket> buckets;
+    double total = 0;
+    for ( size_t i = 0; i != capacity; ++i )
+    {
+        const sample& s = table[i];
+        if ( EMPTY == s.ptr.load(std::memory_order_relaxed) )
+            continue;
+        double scale = interval == 0 ? 1.0 : 1.0 / (1.0 - std::exp( -static_cast<double>(s.size) / interval ));
+        double estimated = s.size * scale;
+        total += estimated;
+        bool merged = false;
+        for ( bucket& b : buckets )
+            if ( b.type == s.type && b.depth == s.depth && std::equal(s.stack, s.stack + s.depth, b.stack) )
+            {
+                ++b.count;
+                b.bytes += s.size;
+                b.estimated += estimated;
+                merged = true;
+                break;
+            }
+        if ( !merged )
+            buckets.push_back( bucket{ s.type, s.depth, s.stack, 1, s.size, estimated } );
+    }
+    std::sort(buckets.begin(), buckets.end(),
+              [](const bucket& a, const bucket& b) { return a.estimated > b.estimated; });
+
+    out.printf("MySTL heap profile: %.0f estimated live bytes, %ld samples, %llu dropped, interval %zu\n",
+               total, live_samples.load(std::memory_order_relaxed),
+               (unsigned long long)dropped_samples.load(std::memory_order_relaxed), interval);
+    for ( const bucket& b : buckets )
+    {
+        out.printf("%12.0f bytes %8llu samples  ", b.estimated, (unsigned long long)b.count);
+        print_type(out, b.type);
+        out << "\n";
+        out.flush();
+        backtrace_symbols_fd(const_cast<void* const*>(b.stack), b.depth, fd);
+    }
+    out.flush();
+}
+
+} // end of namespace MySTL
+#endif // HEAP_PROFILER_H
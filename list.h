@@ -72,6 +72,7 @@ public:
     typedef     const T&                   const_reference;
     typedef     T*                         pointer;
     typedef     T*                         const_pointer;
+    typedef     Alloc                      allocator_type;
 private:
     typedef     _list_node<T>             list_node;
     typedef     list_node*                 node_ptr;
@@ -79,14 +80,15 @@ private:
 
 private:
     node_ptr        ptr_data; // 指向环形链表的空结点;
+    data_allocator  node_alloc; // 节点分配器对象，由构造时传入的分配器 rebind 而来
 
 private:
 
     // 分配一个节点空间
-    node_ptr get_node(){ return data_allocator::allocate();  }
+    node_ptr get_node(){ return node_alloc.allocate();  }
 
     // 释放一个节点空间
-    void free_node( node_ptr p) { data_allocator::deallocate(p); }
+    void free_node( node_ptr p) { node_alloc.deallocate(p); }
 
     // 分配空间构造节点
     node_ptr create_node(const T& x)
@@ -106,6 +108,44 @@ private:
         ptr_data->prev = ptr_data;
     }
 
+    // 逐个插入输入迭代器区间中的元素
+    template <class Iterator>
+    void range_insert(iterator position, Iterator first, Iterator last, std::input_iterator_tag)
+    {
+        for ( ; first != last; ++first )
+            insert(position, *first);
+    }
+    // 前向迭代器可以预先算出元素个数，一次批量分配所有节点
+    template <class Iterator>
+    void range_insert(iterator position, Iterator first, Iterator last, std::forward_iterator_tag)
+    {
+        size_type n = static_cast<size_type>( std::distance(first, last) );
+        node_ptr nodes = batch_allocate(node_alloc, n);
+        for ( ; first != last; ++first, --n )
+        {
+            node_ptr temp = nodes;
+            nodes = batch_next(nodes);
+            try{
+                construct(&temp->data, *first);
+            }
+            catch(...){
+                // 归还尚未使用的节点
+                batch_link(temp, nodes);
+                for ( ; n != 0; --n )
+                {
+                    nodes = batch_next(temp);
+                    free_node(temp);
+                    temp = nodes;
+                }
+                throw;
+            }
+            temp->next = position.ptr_data;
+            temp->prev = position.ptr_data->prev;
+            position.ptr_data->prev->next = temp;
+            position.ptr_data->prev = temp;
+        }
+    }
+
     // 迁移操作
     void transfer( iterator position, iterator first , iterator last)
     {
@@ -127,25 +167,21 @@ private:
 public:
     // 构造函数
     list() { empty_initialize(); }
+    explicit list(const Alloc& a): node_alloc(a) { empty_initialize(); }
 
     // 使用两个迭代器的构造函数
     template <class Iterator>
-    list(Iterator begin,Iterator end) {
+    list(Iterator begin,Iterator end, const Alloc& a = Alloc()): node_alloc(a) {
         empty_initialize();
-        for (;begin != end; ++begin )
-        {
-            push_back(*begin);
-        }
+        insert(this->end(), begin, end);
     }
     // 使用initializer_list 的构造函数
-    list(const std::initializer_list<value_type>& l) {
+    list(const std::initializer_list<value_type>& l, const Alloc& a = Alloc()): node_alloc(a) {
         empty_initialize();
-        for (auto item : l)
-        {
-            push_back(item);
-        }
+        insert(end(), l.begin(), l.end());
     }
 
+    allocator_type get_allocator() const { return allocator_type(node_alloc); }
     bool empty()  { return 0 == size();}
 
     size_type size()  {
@@ -161,6 +197,7 @@ public:
         iterator temp = x.end();
         x.ptr_data = ptr_data;
         ptr_data = temp.ptr_data;
+        std::swap(node_alloc, x.node_alloc);
     }
 
     // 在position处插入元素
@@ -174,6 +211,11 @@ public:
         return temp;
     }
 
+    // 在position处插入区间中的元素
+    template <class Iterator>
+    void insert(iterator position, Iterator first, Iterator last)
+    { range_insert(position, first, last, typename std::iterator_traits<Iterator>::iterator_category()); }
+
     // 从尾部插入元素
     void push_back(const T& val ) { insert(end(),val); }
     // 从首部插入元素
@@ -211,16 +253,25 @@ public:
         return result;
     }
 
-    // 清楚所有元素
+    // 清楚所有元素，节点串起来一次归还给分配器
     void clear()
     {
         node_ptr cur = ptr_data->next;
+        node_ptr first = nullptr;
+        node_ptr last = nullptr;
+        size_type n = 0;
         while( cur != ptr_data )
         {
             node_ptr temp = cur;
             cur = cur->next;
-            destory_node(temp);
+            destory(&temp->data);
+            batch_link(temp, first);
+            if ( nullptr == last )
+                last = temp;
+            first = temp;
+            ++n;
         }
+        batch_deallocate(node_alloc, first, last, n);
         cur->next = cur;
         cur->prev = cur;
     }
@@ -0,0 +1,375 @@
+#ifndef MAPPED_VECTOR_H
+#define MAPPED_VECTOR_H
+
+// 这个文件是 mapped_vector 的头文件
+// mapped_vector<T> 的元素存放在 mmap 到内存的文件中，接口与 vector 相同
+// 数据可以超过物理内存，由内核按页换入换出；进程重启后打开同一个文件即可直接使用，不需要重新读取和解析
+// 文件开头是 64 字节的文件头，记录元素大小和元素个数，之后紧接着是元素本身
+// 只能存放可平凡拷贝的类型，元素中不能有指针之类只在当前进程有效的数据
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>      // for open
+#include <sys/mman.h>   // for mmap, mremap, msync
+#include <sys/stat.h>   // for fstat
+#include <unistd.h>     // for ftruncate, close, sysconf
+
+namespace MySTL {
+
+// mapped_vector 的文件头，占 64 字节，元素从文件的第 64 字节开始
+struct mapped_vector_header{
+    char        magic[8];       // 固定为 "MYSTLVEC"
+    uint64_t    element_size;   // sizeof(T)，打开时检查，防止用错类型
+    uint64_t    size;           // 元素个数，每次修改都直接写在映射的内存中
+    uint64_t    reserved[5];
+};
+
+template<class T>
+class mapped_vector{
+    static_assert(std::is_trivially_copyable<T>::value, "mapped_vector requires a trivially copyable type");
+    static_assert(alignof(T) <= sizeof(mapped_vector_header), "mapped_vector cannot align T");
+
+public:
+    typedef  T*             iterator;
+    typedef  const T*       const_iterator;
+    typedef  T              value_type;
+    typedef  T*             pointer;
+    typedef  const T*       const_pointer;
+    typedef  T&             reference;
+    typedef  const T&       const_reference;
+    typedef  size_t         size_type;
+    typedef  ptrdiff_t      difference_type;
+
+    // 打开方式
+    enum open_mode{
+        read_only,      // 只读映射，文件必须存在，修改元素的操作抛出异常
+        read_write,     // 读写，文件不存在时创建
+        create          // 读写，清空已有的文件
+    };
+
+private:
+    int                     _fd;
+    bool                    _read_only;
+    char*                   _map;           // 整个文件的映射
+    size_t                  _map_bytes;
+    mapped_vector_header*   _header;
+    pointer                 _start;
+    size_type               _capacity;
+
+private:
+    static size_t page_size()
+    {
+        static const size_t size = static_cast<size_t>( sysconf(_SC_PAGESIZE) );
+        return size;
+    }
+    // 容纳 n 个元素的文件长度，取整到页面大小，多出的部分计入容量
+    static size_t file_bytes(size_type n)
+    {
+        size_t bytes = sizeof(mapped_vector_header) + n * sizeof(T);
+        return (bytes + page_size() - 1) & ~(page_size() - 1);
+    }
+
+    static void throw_errno(const char* what) { throw std::system_error(errno, std::generic_category(), what); }
+
+    void check_writable() const
+    {
+        if ( _read_only )
+            throw std::system_error(std::make_error_code(std::errc::read_only_file_system), "mapped_vector is read only");
+    }
+
+    // 映射长度为 bytes 的文件，设置各指针
+    void map(size_t bytes)
+    {
+        int prot = _read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+        void* p = mmap(nullptr, bytes, prot, MAP_SHARED, _fd, 0);
+        if ( MAP_FAILED == p )
+            throw_errno("mapped_vector: mmap");
+        set_map(static_cast<char*>(p), bytes);
+    }
+    void set_map(char* p, size_t bytes)
+    {
+        _map = p;
+        _map_bytes = bytes;
+        _header = reinterpret_cast<mapped_vector_header*>(p);
+        _start = reinterpret_cast<pointer>(p + sizeof(mapped_vector_header));
+        _capacity = (bytes - sizeof(mapped_vector_header)) / sizeof(T);
+    }
+
+    // 文件扩展到 bytes 字节后重新映射，Linux 上用 mremap，内核可以只移动页表
+    void remap(size_t bytes)
+    {
+        if ( ftruncate(_fd, static_cast<off_t>(bytes)) != 0 )
+            throw_errno("mapped_vector: ftruncate");
+#ifdef MREMAP_MAYMOVE
+        void* p = mremap(_map, _map_bytes, bytes, MREMAP_MAYMOVE);
+        if ( MAP_FAILED == p )
+            throw_errno("mapped_vector: mremap");
+        set_map(static_cast<char*>(p), bytes);
+#else
+        munmap(_map, _map_bytes);
+        _map = nullptr;
+        map(bytes);
+#endif
+    }
+
+    // 再放 n 个元素，容量不足时按 2 倍扩展文件
+    void grow(size_type n)
+    {
+        check_writable();
+        if ( _capacity - size() >= n )
+            return;
+        size_type len = 2 * _capacity;
+        remap( file_bytes(len < size() + n ? size() + n : len) );
+    }
+
+    void set_size(size_type n) { _header->size = n; }
+
+    // 打开文件并检查文件头，新文件写入文件头
+    void open(const char* path, open_mode mode)
+    {
+        int flags = read_only == mode ? O_RDONLY : O_RDWR | O_CREAT | (create == mode ? O_TRUNC : 0);
+        _fd = ::open(path, flags | O_CLOEXEC, 0644);
+        if ( _fd < 0 )
+            throw_errno("mapped_vector: open");
+        struct stat st;
+        if ( fstat(_fd, &st) != 0 )
+            throw_errno("mapped_vector: fstat");
+        size_t bytes = static_cast<size_t>(st.st_size);
+        bool fresh = 0 == bytes && !_read_only;
+        if ( !fresh && bytes < sizeof(mapped_vector_header) )
+            throw std::runtime_error("mapped_vector: file is too short");
+        // 读写时把文件补齐到整页，最后一页的余量计入容量
+        if ( !_read_only && file_bytes(0) > bytes )
+            bytes = file_bytes(0);
+        if ( !_read_only && bytes % page_size() != 0 )
+            bytes = (bytes + page_size() - 1) & ~(page_size() - 1);
+        if ( !_read_only && bytes != static_cast<size_t>(st.st_size)
+             && ftruncate(_fd, static_cast<off_t>(bytes)) != 0 )
+            throw_errno("mapped_vector: ftruncate");
+        map(bytes);
+        if ( fresh ){
+            std::memcpy(_header->magic, "MYSTLVEC", 8);
+            _header->element_size = sizeof(T);
+            _header->size = 0;
+        }
+        else if ( std::memcmp(_header->magic, "MYSTLVEC", 8) != 0 )
+            throw std::runtime_error("mapped_vector: not a mapped_vector file");
+        else if ( _header->element_size != sizeof(T) )
+            throw std::runtime_error("mapped_vector: element size does not match");
+        else if ( _header->size > _capacity )
+            throw std::runtime_error("mapped_vector: file is truncated");
+    }
+
+    // 解除映射并关闭文件，shrink 为 true 且可写时把文件截断到实际的元素个数
+    void release(bool shrink = true) noexcept
+    {
+        size_t used = 0;
+        if ( _map ){
+            used = sizeof(mapped_vector_header) + size() * sizeof(T);
+            munmap(_map, _map_bytes);
+        }
+        if ( _fd >= 0 ){
+            if ( shrink && !_read_only && _map )
+                (void)ftruncate(_fd, static_cast<off_t>(used));
+            ::close(_fd);
+        }
+        _fd = -1;
+        _map = nullptr;
+        _map_bytes = 0;
+        _header = nullptr;
+        _start = nullptr;
+        _capacity = 0;
+    }
+
+public:
+    // 打开 path，失败时抛出 std::system_error；文件格式不对时抛出 std::runtime_error
+    explicit mapped_vector(const char* path, open_mode mode = read_write)
+        : _fd(-1), _read_only(read_only == mode), _map(nullptr), _map_bytes(0),
+          _header(nullptr), _start(nullptr), _capacity(0)
+    {
+        try{
+            open(path, mode);
+        }
+        catch(...){
+            // 文件头不对时文件不属于我们，不能截断
+            release(false);
+            throw;
+        }
+    }
+    // 文件只能由一个对象持有，不能拷贝
+    mapped_vector(const mapped_vector&) = delete;
+    mapped_vector& operator=(const mapped_vector&) = delete;
+    mapped_vector(mapped_vector&& x) noexcept
+        : _fd(x._fd), _read_only(x._read_only), _map(x._map), _map_bytes(x._map_bytes),
+          _header(x._header), _start(x._start), _capacity(x._capacity)
+    {
+        x._fd = -1;
+        x._map = nullptr;
+        x.release();
+    }
+    mapped_vector& operator=(mapped_vector&& x) noexcept
+    {
+        if ( &x != this ){
+            release();
+            swap(x);
+        }
+        return *this;
+    }
+    ~mapped_vector() { release(); }
+
+public:
+    iterator begin() { return _start; }
+    iterator end() { return _start + size(); }
+    const_iterator begin() const { return _start; }
+    const_iterator end() const { return _start + size(); }
+    const_iterator cbegin() const { return _start; }
+    const_iterator cend() const { return _start + size(); }
+    pointer data() { return _start; }
+    const_pointer data() const { return _start; }
+
+    size_type size() const { return _header ? static_cast<size_type>(_header->size) : 0; }
+    size_type capacity() const { return _capacity; }
+    bool empty() const { return 0 == size(); }
+    bool is_read_only() const { return _read_only; }
+
+    // 只读打开时通过返回的引用写入会触发 SIGSEGV
+    reference operator[](size_type n) { return _start[n]; }
+    const_reference operator[](size_type n) const { return _start[n]; }
+    reference at(size_type n)
+    { if ( n < size() ) return _start[n]; throw std::out_of_range("mapped_vector: out of range"); }
+    reference front() { return *_start; }
+    reference back() { return _start[size() - 1]; }
+
+    void push_back(const_reference value)
+    {
+        // value 可能引用文件中的元素，重新映射前先拷贝出来
+        value_type value_copy = value;
+        grow(1);
+        _start[size()] = value_copy;
+        set_size(size() + 1);
+    }
+    template<class... Args>
+    reference emplace_back(Args&&... args)
+    {
+        value_type value(std::forward<Args>(args)...);
+        push_back(value);
+        return back();
+    }
+    void pop_back() { check_writable(); set_size(size() - 1); }
+
+    iterator insert(iterator position, const_reference value) { return insert(position, 1, value); }
+    // 在 position 处插入 n 个 value，后面的元素整体后移
+    iterator insert(iterator position, size_type n, const_reference value)
+    {
+        value_type value_copy = value;
+        size_type offset = position - _start;
+        grow(n);
+        position = _start + offset;
+        std::memmove(static_cast<void*>(position + n), position, (size() - offset) * sizeof(T));
+        for ( size_type i = 0; i != n; ++i )
+            position[i] = value_copy;
+        set_size(size() + n);
+        return position;
+    }
+    // 在 position 处插入区间中的元素，只扩展一次文件
+    template<class ForwardIterator, class = typename std::iterator_traits<ForwardIterator>::iterator_category>
+    iterator insert(iterator position, ForwardIterator first, ForwardIterator last)
+    {
+        size_type offset = position - _start;
+        size_type n = static_cast<size_type>( std::distance(first, last) );
+        grow(n);
+        position = _start + offset;
+        std::memmove(static_cast<void*>(position + n), position, (size() - offset) * sizeof(T));
+        for ( iterator cur = position; first != last; ++first, ++cur )
+            *cur = *first;
+        set_size(size() + n);
+        return position;
+    }
+    iterator insert(iterator position, std::initializer_list<value_type> list)
+    { return insert(position, list.begin(), list.end()); }
+    template<class ForwardIterator, class = typename std::iterator_traits<ForwardIterator>::iterator_category>
+    void append(ForwardIterator first, ForwardIterator last) { insert(end(), first, last); }
+
+    iterator erase(iterator position) { return erase(position, position + 1); }
+    iterator erase(iterator first, iterator last)
+    {
+        check_writable();
+        std::memmove(static_cast<void*>(first), last, (end() - last) * sizeof(T));
+        set_size(size() - (last - first));
+        return first;
+    }
+    void clear() { check_writable(); set_size(0); }
+
+    void resize(size_type n) { resize(n, value_type()); }
+    void resize(size_type n, const_reference value)
+    {
+        if ( n > size() )
+            insert(end(), n - size(), value);
+        else
+            erase(_start + n, end());
+    }
+    // 与 vector::resize_for_overwrite 相同，新增的元素不写入任何值
+    // 文件扩展出的部分是空洞，第一次写入时才占用磁盘和内存
+    void resize_for_overwrite(size_type n)
+    {
+        if ( n > size() )
+            grow(n - size());
+        else
+            check_writable();
+        set_size(n);
+    }
+    void reserve(size_type new_cap)
+    {
+        check_writable();
+        if ( new_cap > _capacity )
+            remap( file_bytes(new_cap) );
+    }
+    // 把文件截断到刚好放下现有元素
+    void shrink_to_fit()
+    {
+        check_writable();
+        size_t bytes = file_bytes(size());
+        if ( bytes >= _map_bytes )
+            return;
+        if ( munmap(_map + bytes, _map_bytes - bytes) != 0 )
+            throw_errno("mapped_vector: munmap");
+        set_map(_map, bytes);
+        if ( ftruncate(_fd, static_cast<off_t>(bytes)) != 0 )
+            throw_errno("mapped_vector: ftruncate");
+    }
+
+    // 让内核开始把修改过的页面写回文件，不等待完成
+    void flush()
+    {
+        if ( !_read_only && _map && msync(_map, _map_bytes, MS_ASYNC) != 0 )
+            throw_errno("mapped_vector: msync");
+    }
+    // 把修改过的页面写回文件并等待完成，返回后数据在掉电时也不会丢失
+    void sync()
+    {
+        if ( !_read_only && _map && msync(_map, _map_bytes, MS_SYNC) != 0 )
+            throw_errno("mapped_vector: msync");
+    }
+
+    void swap(mapped_vector& another)
+    {
+        std::swap(_fd, another._fd);
+        std::swap(_read_only, another._read_only);
+        std::swap(_map, another._map);
+        std::swap(_map_bytes, another._map_bytes);
+        std::swap(_header, another._header);
+        std::swap(_start, another._start);
+        std::swap(_capacity, another._capacity);
+    }
+};
+
+} // namespace MySTL
+
+#endif // MAPPED_VECTOR_H
@@ -0,0 +1,347 @@
+// 这个文件定义多态的内存资源 memory_resource 和使用它的 polymorphic_allocator
+// 容器中保存分配器对象，不同的容器可以使用不同的内存资源，
+// 例如给热点 hash_map 一个独立的内存池，或者按租户隔离内存
+
+#ifndef MEMORY_RESOURCE_H
+#define MEMORY_RESOURCE_H
+
+#include "pool_allocator.h"     // for alloc
+#include "arena_allocator.h"    // for monotonic_arena
+#include "construct.h"          // for construct() and destory()
+#include <cstddef>              // for size_t, max_align_t
+#include <cstdint>              // for uintptr_t
+#include <climits>              // for UINT_MAX
+#include <new>                  // for operator new, bad_alloc
+#include <atomic>               // for atomic
+#include <mutex>                // for mutex
+
+namespace MySTL{
+
+// 内存资源的抽象接口
+class memory_resource
+{
+public:
+    virtual ~memory_resource() {}
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    { return do_allocate(bytes, align); }
+    void deallocate(void* p, size_t bytes, size_t align = alignof(std::max_align_t))
+    { do_deallocate(p, bytes, align); }
+    // 一个资源分配的内存能否由另一个资源释放
+    bool is_equal(const memory_resource& other) const { return do_is_equal(other); }
+
+protected:
+    virtual void* do_allocate(size_t bytes, size_t align) = 0;
+    virtual void do_deallocate(void* p, size_t bytes, size_t align) = 0;
+    virtual bool do_is_equal(const memory_resource& other) const { return this == &other; }
+};
+
+inline bool operator==(const memory_resource& a, const memory_resource& b)
+{ return &a == &b || a.is_equal(b); }
+inline bool operator!=(const memory_resource& a, const memory_resource& b)
+{ return !(a == b); }
+
+// 使用全局内存池 alloc 的资源，是默认的资源
+class alloc_resource : public memory_resource
+{
+private:
+    // 对象的对齐要求不会超过其大小的最大 2 的幂因子，默认的 alignof(max_align_t) 对小对象是多余的
+    // 按此收紧后不超过 __ALIGN 的请求走普通的分级链表，不超过 16 的取整到 16 倍数的一级
+    static size_t effective_align(size_t bytes, size_t align)
+    {
+        size_t size_align = bytes & (~bytes + 1);
+        if ( size_align >= align )
+            return align;
+        return size_align < static_cast<size_t>(__ALIGN) ? static_cast<size_t>(__ALIGN) : size_align;
+    }
+
+protected:
+    // 0 字节的请求按最小的一级处理
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        if ( 0 == bytes )
+            bytes = 1;
+        return alloc::allocate_aligned(bytes, effective_align(bytes, align));
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override
+    {
+        if ( 0 == bytes )
+            bytes = 1;
+        alloc::deallocate_aligned(p, bytes, effective_align(bytes, align));
+    }
+    // alloc 是全局唯一的，所有 alloc_resource 可以互相释放
+    bool do_is_equal(const memory_resource& other) const override
+    { return dynamic_cast<const alloc_resource*>(&other) != nullptr; }
+};
+
+// 使用 operator new 和 operator delete 的资源
+// 没有对齐版本的 operator new 时（C++17 之前），超过默认对齐的请求多分配 align 字节，
+// 在返回地址之前保存原始地址，与 alloc 的对齐分配相同
+class new_delete_resource : public memory_resource
+{
+protected:
+#if defined(__cpp_aligned_new)
+    void* do_allocate(size_t bytes, size_t align) override
+    { return ::operator new(bytes, std::align_val_t(align)); }
+    void do_deallocate(void* p, size_t, size_t align) override
+    { ::operator delete(p, std::align_val_t(align)); }
+#else
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        if ( align <= alignof(std::max_align_t) )
+            return ::operator new(bytes);
+        char* raw = static_cast<char*>( ::operator new(bytes + align) );
+        char* result = reinterpret_cast<char*>( (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + align - 1)
+                                                & ~static_cast<uintptr_t>(align - 1) );
+        reinterpret_cast<void**>(result)[-1] = raw;
+        return result;
+    }
+    void do_deallocate(void* p, size_t, size_t align) override
+    {
+        if ( align <= alignof(std::max_align_t) )
+            ::operator delete(p);
+        else
+            ::operator delete( static_cast<void**>(p)[-1] );
+    }
+#endif
+    bool do_is_equal(const memory_resource& other) const override
+    { return dynamic_cast<const new_delete_resource*>(&other) != nullptr; }
+};
+
+// 返回全局的 alloc_resource
+inline memory_resource* pool_memory_resource()
+{
+    static alloc_resource resource;
+    return &resource;
+}
+
+// 返回全局的 new_delete_resource
+inline memory_resource* new_delete_memory_resource()
+{
+    static new_delete_resource resource;
+    return &resource;
+}
+
+// 默认资源，默认构造的 polymorphic_allocator 使用它
+inline std::atomic<memory_resource*>& default_resource_holder()
+{
+    static std::atomic<memory_resource*> resource( pool_memory_resource() );
+    return resource;
+}
+inline memory_resource* get_default_resource()
+{ return default_resource_holder().load(std::memory_order_acquire); }
+// 设置新的默认资源，返回原来的默认资源，传入 nullptr 时恢复为 alloc_resource
+inline memory_resource* set_default_resource(memory_resource* r)
+{
+    return default_resource_holder().exchange(nullptr == r ? pool_memory_resource() : r,
+                                              std::memory_order_acq_rel);
+}
+
+// 单调增长的资源，释放单个对象什么也不做，release() 一次性释放全部内存
+class monotonic_buffer_resource : public memory_resource
+{
+private:
+    monotonic_arena arena;
+
+public:
+    monotonic_buffer_resource() {}
+    explicit monotonic_buffer_resource(size_t block_size) : arena(block_size) {}
+    monotonic_buffer_resource(void* buffer, size_t size) : arena(buffer, size) {}
+
+    void release() { arena.reset(); }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override { return arena.allocate(bytes, align); }
+    void do_deallocate(void*, size_t, size_t) override {}
+};
+
+// 实例私有的内存池，不加锁，只能在一个线程中使用
+// 16 到 512 字节按 16 字节分级，内存块和更大的对象向上游资源索要，析构时一次性归还所有内存块
+// 与 std::pmr 一样，未指定上游时使用构造时的默认资源 get_default_resource()
+class unsynchronized_pool_resource : public memory_resource
+{
+private:
+    enum { ALIGN = 16 };
+    enum { MAX_BYTES = 512 };
+    enum { NUM_LIST = static_cast<int>(MAX_BYTES) / ALIGN };
+    enum { MIN_CHUNK = 4096, MAX_CHUNK = 256 * 1024 };
+
+    struct obj{
+        obj* next;
+    };
+    // 从上游取得的内存块，头部记录链表指针和大小
+    struct chunk{
+        chunk* next;
+        size_t size;
+    };
+
+    memory_resource* upstream;
+    obj*   free_list[ NUM_LIST ];
+    chunk* chunks;
+    char*  cur;             // 当前内存块中尚未切分的部分
+    char*  end;
+    size_t next_chunk_size; // 下一个内存块的大小，按 2 倍增长到 MAX_CHUNK
+
+    static size_t index_of(size_t bytes) { return (bytes + ALIGN - 1) / ALIGN - 1; }
+
+    // 链表为空时从当前内存块切出一个对象，不够时向上游索要新的内存块
+    void* carve(size_t size)
+    {
+        if ( static_cast<size_t>(end - cur) < size )
+        {
+            size_t header = (sizeof(chunk) + ALIGN - 1) & ~static_cast<size_t>(ALIGN - 1);
+            chunk* c = static_cast<chunk*>( upstream->allocate(next_chunk_size, ALIGN) );
+            c->size = next_chunk_size;
+            c->next = chunks;
+            chunks = c;
+            cur = reinterpret_cast<char*>(c) + header;
+            end = reinterpret_cast<char*>(c) + c->size;
+            if ( next_chunk_size < static_cast<size_t>(MAX_CHUNK) )
+                next_chunk_size *= 2;
+        }
+        char* result = cur;
+        cur += size;
+        return result;
+    }
+
+public:
+    explicit unsynchronized_pool_resource(memory_resource* up = get_default_resource())
+        : upstream(up), free_list(), chunks(nullptr), cur(nullptr), end(nullptr), next_chunk_size(MIN_CHUNK) {}
+    unsynchronized_pool_resource(const unsynchronized_pool_resource&) = delete;
+    unsynchronized_pool_resource& operator=(const unsynchronized_pool_resource&) = delete;
+    ~unsynchronized_pool_resource() { release(); }
+
+    // 把所有内存块还给上游，之前分配出去的小对象全部作废
+    void release()
+    {
+        while ( chunks != nullptr )
+        {
+            chunk* next = chunks->next;
+            upstream->deallocate(chunks, chunks->size, ALIGN);
+            chunks = next;
+        }
+        for ( size_t i = 0; i != NUM_LIST; ++i )
+            free_list[i] = nullptr;
+        cur = end = nullptr;
+        next_chunk_size = MIN_CHUNK;
+    }
+
+    memory_resource* upstream_resource() const { return upstream; }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        if ( bytes > static_cast<size_t>(MAX_BYTES) || align > static_cast<size_t>(ALIGN) )
+            return upstream->allocate(bytes, align);
+        if ( 0 == bytes )
+            bytes = 1;
+        size_t index = index_of(bytes);
+        obj* result = free_list[index];
+        if ( nullptr == result )
+            return carve( (index + 1) * ALIGN );
+        free_list[index] = result->next;
+        return result;
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override
+    {
+        if ( bytes > static_cast<size_t>(MAX_BYTES) || align > static_cast<size_t>(ALIGN) )
+        {
+            upstream->deallocate(p, bytes, align);
+            return;
+        }
+        if ( 0 == bytes )
+            bytes = 1;
+        size_t index = index_of(bytes);
+        obj* free = static_cast<obj*>(p);
+        free->next = free_list[index];
+        free_list[index] = free;
+    }
+};
+
+// 加锁的实例私有内存池，可以在多个线程中使用
+class synchronized_pool_resource : public unsynchronized_pool_resource
+{
+private:
+    std::mutex lock;
+
+public:
+    explicit synchronized_pool_resource(memory_resource* up = new_delete_memory_resource())
+        : unsynchronized_pool_resource(up) {}
+
+    void release()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        unsynchronized_pool_resource::release();
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return unsynchronized_pool_resource::do_allocate(bytes, align);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        unsynchronized_pool_resource::do_deallocate(p, bytes, align);
+    }
+};
+
+// 保存一个 memory_resource 指针的有状态分配器，可用于所有容器
+template <class T>
+class polymorphic_allocator
+{
+
+public:
+    typedef T             value_type;
+    typedef T*            pointer;
+    typedef const T*      const_pointer;
+    typedef T&            reference;
+    typedef const T&      const_reference;
+    typedef size_t        size_type;
+    typedef ptrdiff_t     ptrdiff_type;
+
+private:
+    memory_resource* resource;
+
+public:
+    polymorphic_allocator() : resource(get_default_resource()) {}
+    polymorphic_allocator(memory_resource* r) : resource(r) {}
+    template <class U>
+    polymorphic_allocator(const polymorphic_allocator<U>& other) : resource(other.get_resource()) {}
+
+    memory_resource* get_resource() const { return resource; }
+
+public:
+    T* allocate(size_t n)
+    { return 0 == n? 0 : static_cast<T*>( resource->allocate( n*sizeof(T), alignof(T) )); }
+    T* allocate() { return static_cast<T*>( resource->allocate( sizeof(T), alignof(T) )); }
+    void deallocate(T* p, size_t n ) { if (0 != n) resource->deallocate( p, n*sizeof(T), alignof(T) ); }
+    void deallocate(T* p) { resource->deallocate(p, sizeof(T), alignof(T)); }
+
+public:
+    template <class U>
+    struct rebind
+    {
+        typedef polymorphic_allocator<U> other;
+    };
+
+public:
+    static void construct(pointer p,const T& value) { MySTL::construct(p,value); }
+    static void destory(pointer p) { MySTL::destory(p); }
+    pointer address(reference x) { return static_cast<pointer>(&x); }
+    const_pointer address(const_reference x) { return static_cast<const_pointer>(&x); }
+    size_type max_size() const { return static_cast<size_type>( UINT_MAX/sizeof(T) ); }
+
+};
+
+template <class T, class U>
+inline bool operator==(const polymorphic_allocator<T>& a, const polymorphic_allocator<U>& b)
+{ return *a.get_resource() == *b.get_resource(); }
+template <class T, class U>
+inline bool operator!=(const polymorphic_allocator<T>& a, const polymorphic_allocator<U>& b)
+{ return !(a == b); }
+
+
+} // end of namespace MySTL
+#endif // MEMORY_RESOURCE_H
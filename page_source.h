@@ -0,0 +1,149 @@
+// 这个文件定义内存池向系统索要内存块的策略 page_source
+// mmap_page_source 每次直接 mmap，huge_page_source 预留大段地址空间并请求透明大页
+// 通过 alloc::set_page_source() 选择，或者定义 MYSTL_HUGE_PAGES 使默认策略为 huge_page_source
+
+#ifndef PAGE_SOURCE_H
+#define PAGE_SOURCE_H
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uintptr_t
+#include <cstdio>       // for fopen, fgets
+#include <cstring>      // for strstr
+#include <mutex>        // for mutex
+#include <sys/mman.h>   // for mmap, munmap, madvise
+#include <unistd.h>     // for sysconf
+
+namespace MySTL{
+
+// 页面来源的抽象接口
+class page_source
+{
+public:
+    virtual ~page_source() {}
+
+    // 返回至少 bytes 字节、按 granularity() 对齐的内存，失败时返回 nullptr
+    virtual void* allocate(size_t bytes) = 0;
+
+    // 把物理内存还给系统，地址必须保持可读写
+    virtual void decommit(void* p, size_t bytes) = 0;
+
+    // 内存块大小的取整单位
+    virtual size_t granularity() const = 0;
+
+    static size_t page_size()
+    {
+        static const size_t size = static_cast<size_t>( sysconf(_SC_PAGESIZE) );
+        return size;
+    }
+};
+
+// 每个内存块单独 mmap，使用普通页
+class mmap_page_source : public page_source
+{
+public:
+    void* allocate(size_t bytes) override
+    {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return MAP_FAILED == p ? nullptr : p;
+    }
+
+    void decommit(void* p, size_t bytes) override { madvise(p, bytes, MADV_DONTNEED); }
+
+    size_t granularity() const override { return page_size(); }
+};
+
+// 预留大段按 2MB 对齐的地址空间，从中依次切出内存块，并用 MADV_HUGEPAGE 请求透明大页
+// 内核不支持或关闭了透明大页时仍然可用，只是退化为普通页
+class huge_page_source : public page_source
+{
+private:
+    enum { HUGE_PAGE_SIZE = 2 * 1024 * 1024 };
+
+    size_t reserve_bytes;   // 每次预留的地址空间大小
+    char*  cur;             // 预留区中下一个可用的位置
+    char*  end;
+    bool   use_huge_pages;  // 系统是否启用了透明大页
+    std::mutex lock;
+
+    // 读取 /sys/kernel/mm/transparent_hugepage/enabled，为 [never] 或文件不存在时视为不可用
+    static bool huge_pages_supported()
+    {
+#ifdef MADV_HUGEPAGE
+        std::FILE* f = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if ( nullptr == f )
+            return false;
+        char buf[128] = {0};
+        bool result = std::fgets(buf, sizeof(buf), f) != nullptr && std::strstr(buf, "[never]") == nullptr;
+        std::fclose(f);
+        return result;
+#else
+        return false;
+#endif
+    }
+
+    // 预留至少 bytes 字节按大页对齐的地址空间，多出的头尾还给系统
+    bool reserve(size_t bytes)
+    {
+        size_t size = bytes > reserve_bytes ? bytes : reserve_bytes;
+        size_t mapped = size + HUGE_PAGE_SIZE;
+        void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if ( MAP_FAILED == p )
+            return false;
+        char* raw = static_cast<char*>(p);
+        char* aligned = reinterpret_cast<char*>( (reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_SIZE - 1)
+                                                 & ~static_cast<uintptr_t>(HUGE_PAGE_SIZE - 1) );
+        if ( aligned != raw )
+            munmap(raw, aligned - raw);
+        if ( raw + mapped != aligned + size )
+            munmap(aligned + size, raw + mapped - (aligned + size));
+#ifdef MADV_HUGEPAGE
+        // 失败说明内核不支持，继续使用普通页
+        if ( use_huge_pages && madvise(aligned, size, MADV_HUGEPAGE) != 0 )
+            use_huge_pages = false;
+#endif
+        cur = aligned;
+        end = aligned + size;
+        return true;
+    }
+
+public:
+    explicit huge_page_source(size_t reserve = size_t(1) << 30)
+        : reserve_bytes(reserve), cur(nullptr), end(nullptr), use_huge_pages(huge_pages_supported()) {}
+
+    void* allocate(size_t bytes) override
+    {
+        bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~static_cast<size_t>(HUGE_PAGE_SIZE - 1);
+        std::lock_guard<std::mutex> guard(lock);
+        if ( static_cast<size_t>(end - cur) < bytes && !reserve(bytes) )
+        {
+            // 无法预留大段地址空间时，退回到单独 mmap
+            void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return MAP_FAILED == p ? nullptr : p;
+        }
+        char* result = cur;
+        cur += bytes;
+        return result;
+    }
+
+    void decommit(void* p, size_t bytes) override { madvise(p, bytes, MADV_DONTNEED); }
+
+    size_t granularity() const override { return HUGE_PAGE_SIZE; }
+
+    // 透明大页是否可用，不可用时所有内存使用普通页
+    bool huge_pages_enabled() const { return use_huge_pages; }
+};
+
+// 默认的页面来源，定义 MYSTL_HUGE_PAGES 时使用透明大页
+inline page_source* default_page_source()
+{
+#ifdef MYSTL_HUGE_PAGES
+    static huge_page_source source;
+#else
+    static mmap_page_source source;
+#endif
+    return &source;
+}
+
+} // end of namespace MySTL
+#endif // PAGE_SOURCE_H
@@ -1,179 +1,1149 @@
 // 这个文件以内存池的形式来分配内存
+// 每个线程在共享的内存池前面有一层线程本地缓存，线程缓存与中心链表之间按批次搬运对象
+// 中心链表是带版本号的无锁栈，内存块的切分也是无锁的，只有向系统索要新内存块时才加锁
+// 128 字节以内按 8 字节分级，128 字节到 32KB 之间按几何级数分级（每翻一倍分 4 级），更大的直接 malloc
+// 内存块从可替换的 page_source 获得，trim() 找出完全空闲的内存块，把物理内存还给系统
+// stats() 返回各级链表的统计信息，计数器按线程分开存放，快速路径上没有原子的读改写指令
+// refill 一次切出的对象个数按链表各自调整：从 2 个开始，每次 refill 翻倍，线程缓存溢出时减半
+// 小对象保证 8 字节对齐，大小为 16 倍数的小对象、中等对象和 malloc 保证 16 字节对齐，更大的对齐要求使用 allocate_aligned()
+// allocate_batch()/deallocate_batch() 一次搬运同一级的多个对象，供节点式容器批量建立和清空
+// 所有分配和释放都经过 heap_profiler 的采样钩子，pool_allocator 同时传入节点类型
 
 #ifndef POOL_ALLOCATOR_H
 #define POOL_ALLOCATOR_H
 
 #include "construct.h"  // for construct() and destory()
+#include "page_source.h" // for page_source
+#include "heap_profiler.h" // for heap_profiler
 #include <cstddef>      // for size_t
+#include <cstdint>      // for uint64_t, uintptr_t
+#include <cstdlib>      // for malloc, free, realloc
+#include <cstring>      // for memcpy
+#include <new>          // for bad_alloc
 #include <iostream>     // for cerr
 #include <climits>      // for UINT_MAX
+#include <atomic>       // for atomic
+#include <mutex>        // for mutex
+#include <thread>       // for thread
+#include <chrono>       // for milliseconds
+#include <vector>       // for std::vector, 只在 trim 中使用
+#include <algorithm>    // for std::sort
+#include <csignal>      // for signal
+#include <unistd.h>     // for write
 
 namespace MySTL{
 
 enum { __ALIGN = 8 };                               // 调整边界
 enum { __MAX_BYTES = 128 };                         // 最大上界
-enum { __NUM_FREE_LIST = __MAX_BYTES/__ALIGN };     // 链表个数
+enum { __NUM_FREE_LIST = static_cast<int>(__MAX_BYTES)/__ALIGN };    // 链表个数
+enum { __MEDIUM_ALIGN = 16 };                       // 中等对象的对齐边界，与 malloc 保持一致
+enum { __MAX_MEDIUM_BYTES = 32768 };                // 中等对象的上界，更大的直接 malloc
+enum { __MEDIUM_STEPS = 4 };                        // 中等对象每翻一倍划分的级数
+enum { __NUM_MEDIUM_LIST = 8 * __MEDIUM_STEPS };    // 中等对象链表个数，128 到 32768 共翻 8 倍
+enum { __NUM_SIZE_CLASS = static_cast<int>(__NUM_FREE_LIST) + __NUM_MEDIUM_LIST }; // 链表总数
+enum { __BATCH_BYTES = 8192 };                      // 线程缓存与中心链表之间一次搬运的大致字节数
+enum { __MAX_BATCH = 32 };                          // 一次搬运的最大对象个数
+enum { __REFILL_BYTES = 65536 };                    // 一次 refill 至多切出的大致字节数
+enum { __MIN_REFILL = 2 };                          // 一次 refill 切出的初始对象个数
+enum { __MAX_REFILL = 128 };                        // 一次 refill 切出的最大对象个数
+enum { __MAX_SPAN_BYTES = 1 << 20 };                // 单个内存块的上限，越小越容易整块归还
+
+// alloc 的统计信息快照，由 alloc::stats() 返回
+struct alloc_stats
+{
+    // 每一级链表的统计
+    struct size_class{
+        size_t   size;           // 对象大小
+        uint64_t allocations;    // 分配次数
+        uint64_t frees;          // 释放次数
+        uint64_t cache_hits;     // 直接从线程缓存取到的次数
+        uint64_t central_hits;   // 线程缓存为空，从中心链表取到的次数
+        uint64_t refills;        // 中心链表也为空，调用 refill 的次数
+        size_t   idle_bytes;     // 闲置在中心链表和各线程缓存中的字节数
+    };
+    size_class classes[ __NUM_SIZE_CLASS ];
+
+    uint64_t chunk_alloc_calls;  // chunk_alloc 调用次数
+    uint64_t system_bytes;       // 累计向系统索要的字节数
+    uint64_t released_bytes;     // 累计通过 trim 还给系统的字节数
+    size_t   heap_size;          // 当前内存块占用的字节数
+    size_t   idle_bytes;         // 闲置在各级链表中的字节数之和
+    uint64_t large_allocations;  // 超过 __MAX_MEDIUM_BYTES 直接 malloc 的次数
+    uint64_t large_frees;        // 直接 free 的次数
+    uint64_t large_bytes;        // 直接 malloc 的累计字节数
+};
 
 class alloc
 {
 private:
     // 定义内嵌指针以形成链表
+    // next 用 relaxed 的原子读写：中心链表 pop 时读到的 p->next 可能正被取走 p 的线程或 trim 改写，
+    // 旧值会因版本号不符而被 CAS 丢弃，但普通读写仍是数据竞争；relaxed 访问生成的代码与普通读写相同
     struct obj{
-        obj* next;
+        struct link{
+            std::atomic<obj*> value;
+
+            operator obj*() const { return value.load(std::memory_order_relaxed); }
+            obj* operator->() const { return value.load(std::memory_order_relaxed); }
+            link& operator=(obj* p) { value.store(p, std::memory_order_relaxed); return *this; }
+            link& operator=(const link& x) { return *this = static_cast<obj*>(x); }
+        };
+        link next;
+    };
+    static_assert(sizeof(obj) == sizeof(obj*), "obj::next must have the layout of a plain pointer");
+
+    // 带版本号的无锁栈，作为中心链表使用
+    // 指针与版本号压缩在一个 64 位字中，每次修改版本号加一，以此防止 ABA 问题
+    // 64 位平台上对象按 8 字节对齐且地址不超过 48 位，指针右移 3 位后占 45 位，其余 19 位作版本号
+    class central_list{
+    private:
+        enum { PTR_SHIFT = sizeof(void*) == 8 ? 3 : 0 };
+        enum { PTR_BITS  = sizeof(void*) == 8 ? 45 : 32 };
+
+        static obj* ptr(uint64_t word)
+        { return reinterpret_cast<obj*>( static_cast<uintptr_t>( (word & ((uint64_t(1) << PTR_BITS) - 1)) << PTR_SHIFT ) ); }
+        static uint64_t tag(uint64_t word) { return word >> PTR_BITS; }
+        static uint64_t pack(obj* p, uint64_t t)
+        { return (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(p)) >> PTR_SHIFT) | (t << PTR_BITS); }
+
+    public:
+        std::atomic<uint64_t> head;
+        std::atomic<long>     length;   // 链表长度，仅用于统计，可能短暂地不准确
+
+        // 把 first 到 last 的 count 个对象一次压入栈顶
+        void push(obj* first, obj* last, size_t count)
+        {
+            uint64_t old = head.load(std::memory_order_relaxed);
+            do{
+                last->next = ptr(old);
+            }while ( !head.compare_exchange_weak(old, pack(first, tag(old) + 1),
+                                                 std::memory_order_release, std::memory_order_relaxed) );
+            length.fetch_add(static_cast<long>(count), std::memory_order_relaxed);
+        }
+        // 弹出一个对象，栈为空时返回 nullptr
+        // 读 p->next 时 p 可能已被其他线程取走，读到的旧值会因版本号不符而被 CAS 丢弃
+        // 物理内存由 trim 归还后页面仍然映射，读到的是 0，不会出错
+        // 取走 p 的线程随后会以普通写入使用这段内存，这次推测性的读取对 ThreadSanitizer 隐藏，
+        // 否则用户代码中每次使用刚分配的对象都会被报告为与这里竞争
+#if defined(__GNUC__)
+        __attribute__((no_sanitize_thread))
+#endif
+        static obj* speculative_next(obj* p)
+        { return *reinterpret_cast<obj* const volatile*>(&p->next); }
+
+        obj* pop()
+        {
+            uint64_t old = head.load(std::memory_order_acquire);
+            for (;;)
+            {
+                obj* p = ptr(old);
+                if ( nullptr == p )
+                    return nullptr;
+                if ( head.compare_exchange_weak(old, pack(speculative_next(p), tag(old) + 1),
+                                                std::memory_order_acquire, std::memory_order_acquire) )
+                {
+                    length.fetch_sub(1, std::memory_order_relaxed);
+                    return p;
+                }
+            }
+        }
+        // 一次取走整个链表，由调用者修正 length
+        obj* take_all()
+        {
+            uint64_t old = head.load(std::memory_order_relaxed);
+            while ( !head.compare_exchange_weak(old, pack(nullptr, tag(old) + 1),
+                                                std::memory_order_acquire, std::memory_order_relaxed) )
+                ;
+            return ptr(old);
+        }
+    };
+
+    // 内存块的描述信息，与内存本身分开存放，以便整块归还给系统
+    // cur 之后到 end 之间是尚未切分的内存
+    struct chunk{
+        std::atomic<char*> cur;
+        char* begin;
+        char* end;
+        chunk* next;        // 所有内存块串成链表，由 grow_lock 保护
+        page_source* source; // 内存块的来源，归还物理内存时使用
+        bool released;      // 物理内存已经还给系统，等待复用
+    };
+
+    // 只由所属线程修改、允许其他线程读取的计数器
+    // 修改时用 relaxed 的读和写代替读改写指令，代价与普通变量相同
+    struct local_counter{
+        std::atomic<size_t> value;
+
+        operator size_t() const { return value.load(std::memory_order_relaxed); }
+        local_counter& operator+=(size_t n)
+        { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); return *this; }
+        local_counter& operator-=(size_t n)
+        { value.store(value.load(std::memory_order_relaxed) - n, std::memory_order_relaxed); return *this; }
+        local_counter& operator++() { return *this += 1; }
+        local_counter& operator--() { return *this -= 1; }
+    };
+
+    // 线程本地缓存，每个链表记录自身长度，过长时归还一批给中心链表
+    struct thread_cache{
+        obj*          free_list[ __NUM_SIZE_CLASS ];
+        local_counter length[ __NUM_SIZE_CLASS ];
+
+        // 统计信息
+        local_counter alloc_count[ __NUM_SIZE_CLASS ];
+        local_counter free_count[ __NUM_SIZE_CLASS ];
+        local_counter central_hit_count[ __NUM_SIZE_CLASS ];
+        local_counter refill_count[ __NUM_SIZE_CLASS ];
+
+        size_t refill_num[ __NUM_SIZE_CLASS ];      // 下一次 refill 切出的对象个数，0 表示尚未使用
+
+        thread_cache* next_cache;   // 所有已登记的线程缓存串成链表，由 stats_lock 保护
+        bool registered;
+        bool exited;
+    };
+
+    // 线程退出时把线程缓存中的对象归还给中心链表，并注销统计信息
+    struct thread_cache_cleaner{
+        ~thread_cache_cleaner() { alloc::flush_thread_cache(); alloc::unregister_thread_cache(); }
     };
 
     // 调整分配的字节数到8的倍数
     static size_t Round_up(size_t bytes) { return ( (bytes + __ALIGN - 1 ) & ~(__ALIGN - 1) ); }
+    // 取整到 16 的倍数，0 按 16 处理
+    static size_t Round_up_medium(size_t bytes)
+    { return 0 == bytes ? static_cast<size_t>(__MEDIUM_ALIGN) : ( (bytes + __MEDIUM_ALIGN - 1) & ~static_cast<size_t>(__MEDIUM_ALIGN - 1) ); }
+
+    // 向下取整的 log2
+    static size_t Log2_floor(size_t x) {
+#if defined(__GNUC__)
+        return sizeof(unsigned long long) * CHAR_BIT - 1 - __builtin_clzll(x);
+#else
+        size_t k = 0;
+        for ( ; x > 1; x >>= 1) ++k;
+        return k;
+#endif
+    }
 
     //计算所处的链表索引
     static size_t Freelist_index(size_t bytes) {
-        return (bytes + __ALIGN - 1)/__ALIGN - 1;
+        if ( bytes <= static_cast<size_t>(__MAX_BYTES) )
+            return (bytes + __ALIGN - 1)/__ALIGN - 1;
+        // 2^p < bytes <= 2^(p+1)，该区间等分为 __MEDIUM_STEPS 级
+        size_t p = Log2_floor(bytes - 1);
+        size_t step_shift = p - 2;
+        size_t sub = (bytes - (size_t(1) << p) + (size_t(1) << step_shift) - 1) >> step_shift;
+        return __NUM_FREE_LIST + (p - 7) * __MEDIUM_STEPS + sub - 1;
+    }
+
+    // 链表索引对应的对象大小
+    static size_t Class_size(size_t index) {
+        if ( index < static_cast<size_t>(__NUM_FREE_LIST) )
+            return (index + 1) * __ALIGN;
+        size_t m = index - __NUM_FREE_LIST;
+        size_t p = 7 + m / __MEDIUM_STEPS;
+        return (size_t(1) << p) + (m % __MEDIUM_STEPS + 1) * (size_t(1) << (p - 2));
+    }
+
+    // 线程缓存与中心链表之间一次搬运的对象个数
+    static size_t Batch_num(size_t bytes) {
+        size_t num = __BATCH_BYTES / bytes;
+        return num > __MAX_BATCH ? static_cast<size_t>(__MAX_BATCH) : (num < 2 ? 2 : num);
+    }
+
+    // 一次 refill 从内存池切出的对象个数的上限
+    static size_t Max_refill_num(size_t bytes) {
+        size_t num = __REFILL_BYTES / bytes;
+        return num > __MAX_REFILL ? static_cast<size_t>(__MAX_REFILL) : (num < __MIN_REFILL ? static_cast<size_t>(__MIN_REFILL) : num);
+    }
+
+    // 线程缓存超过这个长度时归还一批给中心链表，不小于刚 refill 进来的个数
+    static size_t Max_cache_length(const thread_cache& cache, size_t index) {
+        size_t limit = 2 * Batch_num(Class_size(index));
+        return cache.refill_num[index] > limit ? cache.refill_num[index] : limit;
     }
 
 private:
-    // 挂载内存池中的内存到free_list
-    static void* refill(size_t n);
+    // 从内存池切出一批对象，一个返回给调用者，其余挂到线程缓存
+    static void* refill(thread_cache& cache, size_t n);
 
-    // 分配内存到内存池
+    // 从当前内存块无锁地切出 nobjs 个大小为 size 的对象，不足时换上新的内存块
     static char* chunk_alloc(size_t size, int &nobjs );
 
+    // 当前内存块 old 不够用时，向系统索要新的内存块
+    static void grow_pool(chunk* old, size_t total_bytes);
+
+    // 线程缓存为空时，从中心链表取一批对象放入线程缓存，并返回其中一个
+    static void* fetch_from_central(thread_cache& cache, size_t n);
+
+    // 将线程缓存中某个链表头部的 num 个对象归还给中心链表
+    static void release_to_central(thread_cache& cache, size_t index, size_t num);
+
+    // 后台线程，每隔 trim_interval_ms 毫秒调用一次 trim()
+    static void trim_loop();
+
+    // 首次进入慢速路径时登记当前线程的缓存，使 stats() 能看到它
+    static void register_thread_cache();
+    static void unregister_thread_cache();
+
+    // 把 cache 中的统计累加到 result 中
+    static void collect_stats(const thread_cache& cache, alloc_stats& result);
+
+    // 只读取全局原子计数的统计快照，不加锁，可以在信号处理函数中调用
+    static alloc_stats global_stats();
+    // 由各级链表的计数算出 cache_hits 和 idle_bytes 总和
+    static void summarize_stats(alloc_stats& result);
+    // 把 result 以文本形式写到文件描述符 fd，只使用 write
+    static void write_stats(int fd, const alloc_stats& result, bool per_thread);
+
+    // 信号处理函数，把全局统计写到标准错误；线程缓存由锁保护，不在这里读取
+    static void stats_signal_handler(int);
+
+    // 以下是不经过 heap_profiler 的分配和释放，由对应的公有函数调用
+    static void* pool_allocate(size_t n);
+    static void  pool_deallocate(void* p, size_t n);
+    static void* pool_allocate_aligned(size_t n, size_t align);
+    static void  pool_deallocate_aligned(void* p, size_t n, size_t align);
+    static void* pool_allocate_batch(size_t n, size_t count);
+
 private:
-    // 链表数组，分别管理一个链表，每个链表所连内存大小不同
-    static obj* free_list[ __NUM_FREE_LIST ];
+    // 中心链表数组，分别管理一个链表，每个链表所连内存大小不同
+    static central_list free_list[ __NUM_SIZE_CLASS ];
+
+    static std::atomic<chunk*> current_chunk;   // 正在切分的内存块
+    static chunk* all_chunks;                   // 所有内存块，由 grow_lock 保护
+    static std::atomic<size_t> heap_size;       // 内存块占用的内存总量，只在持有 grow_lock 时修改
+    static std::mutex grow_lock;                // 只在换内存块和 trim 时使用
+
+    static std::atomic<long> trim_interval_ms;  // 后台 trim 的周期，0 表示关闭
+    static std::atomic<page_source*> pages;     // 新内存块的来源，为空时使用 default_page_source()
 
-    static char* start_pool;     // 指向内存池头
-    static char*   end_pool;     // 指向内存池尾
-    static size_t heap_size;     // 已分配内存的累积量
+    // 全局的统计信息，只在慢速路径上修改
+    static std::atomic<uint64_t> chunk_alloc_calls;
+    static std::atomic<uint64_t> system_bytes;
+    static std::atomic<uint64_t> released_bytes;
+    static std::atomic<uint64_t> large_allocations;
+    static std::atomic<uint64_t> large_frees;
+    static std::atomic<uint64_t> large_bytes;
+
+    static thread_cache* all_caches;            // 已登记的线程缓存
+    static thread_cache  exited_caches;         // 已退出线程的统计之和
+    static std::mutex stats_lock;               // 保护 all_caches 和 exited_caches
+
+    static thread_local thread_cache tcache;    // 当前线程的缓存
 
 public:
     static void * allocate(size_t n,const void* hint = 0);
     static void  deallocate(void *p, size_t n);
 
+    // 与 allocate 相同，heap_profiler 采样时记录 type 作为对象的类型
+    static void* allocate_typed(size_t n, const char* type);
+
+    // 分配 n 字节、按 align 对齐的内存，align 为 2 的幂，释放时须传入相同的 n 和 align
+    // 16 字节以内借助中等对象的对齐；更大的从内存池多取 align 字节，在返回地址前保存原地址
+    static void* allocate_aligned(size_t n, size_t align, const char* type = nullptr);
+    static void  deallocate_aligned(void* p, size_t n, size_t align);
+
+    // 把 old_n 字节的 p 调整为 new_n 字节，内容按字节保留，只能用于可以按字节搬移的对象
+    // 两端都超过 __MAX_MEDIUM_BYTES 时交给 realloc，大块内存由 mremap 原地扩展或搬移页面，不复制数据
+    static void* reallocate(void* p, size_t old_n, size_t new_n, const char* type = nullptr);
+
+    // 申请 n 字节时实际拿到的字节数，即所在级别的对象大小，多出的部分调用者可以直接使用
+    // 按这个大小释放或 reallocate 与按 n 等价；超过 __MAX_MEDIUM_BYTES 的直接 malloc，不做取整
+    static size_t usable_size(size_t n)
+    {
+        if ( 0 == n || n > static_cast<size_t>(__MAX_MEDIUM_BYTES) )
+            return n;
+        return Class_size(Freelist_index(n));
+    }
+
+    // 一次分配 count 个大小为 n 的对象，通过每个对象开头的指针串成以 nullptr 结尾的链表
+    // 先取线程缓存和中心链表，不足的部分直接从内存块连续切出，不逐个弹出
+    static void* allocate_batch(size_t n, size_t count, const char* type = nullptr);
+    // 一次归还 first 到 last 串成的 count 个大小为 n 的对象，整条链表接到线程缓存上
+    static void  deallocate_batch(void* first, void* last, size_t n, size_t count);
+
+    // 把当前线程缓存中的对象全部归还给中心链表
+    static void flush_thread_cache();
+
+    // 把完全空闲的内存块的物理内存还给系统，返回归还的字节数
+    // 只能看到中心链表中的对象，其他线程缓存中的对象会让所在内存块继续保留
+    static size_t trim();
+
+    // 设置后台 trim 的周期，0 表示关闭，第一次设为非 0 时启动后台线程
+    static void set_trim_interval(std::chrono::milliseconds interval);
+
+    // 设置新内存块的来源，已有的内存块仍由原来的来源管理，容器代码无需改动
+    static void set_page_source(page_source* source) { pages.store(source, std::memory_order_release); }
+    static page_source* get_page_source()
+    {
+        page_source* source = pages.load(std::memory_order_acquire);
+        return nullptr == source ? default_page_source() : source;
+    }
+
+    // 返回统计信息的快照，其他线程的计数可能有少量滞后
+    static alloc_stats stats();
+
+    // 把统计信息以文本形式写到文件描述符 fd，需要加锁，不能在信号处理函数中调用
+    static void dump_stats(int fd);
+
+    // 收到信号 sig 时把统计信息写到标准错误，只包含中心链表和全局计数，不包含各线程缓存的计数
+    static void install_stats_signal(int sig = SIGUSR2);
 
 };
 
-char * alloc::start_pool = nullptr;
-char * alloc::end_pool   = nullptr;
-size_t alloc::heap_size  = 0;
-alloc::obj* alloc::free_list[ __NUM_FREE_LIST ] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+alloc::central_list alloc::free_list[ __NUM_SIZE_CLASS ];
+std::atomic<alloc::chunk*> alloc::current_chunk( nullptr );
+alloc::chunk* alloc::all_chunks = nullptr;
+std::atomic<size_t> alloc::heap_size( 0 );
+std::mutex alloc::grow_lock;
+std::atomic<long> alloc::trim_interval_ms( 0 );
+std::atomic<page_source*> alloc::pages( nullptr );
+std::atomic<uint64_t> alloc::chunk_alloc_calls( 0 );
+std::atomic<uint64_t> alloc::system_bytes( 0 );
+std::atomic<uint64_t> alloc::released_bytes( 0 );
+std::atomic<uint64_t> alloc::large_allocations( 0 );
+std::atomic<uint64_t> alloc::large_frees( 0 );
+std::atomic<uint64_t> alloc::large_bytes( 0 );
+alloc::thread_cache* alloc::all_caches = nullptr;
+alloc::thread_cache  alloc::exited_caches;
+std::mutex alloc::stats_lock;
+thread_local alloc::thread_cache alloc::tcache;
 
 void * alloc::allocate(size_t n,const void* hint)
 {
-    obj* result;
-    obj** current_free_list = free_list + Freelist_index(n); // 当前负责分配内存的链表的指针
+    void* p = pool_allocate(n);
+    heap_profiler::on_allocate(p, n, nullptr);
+    return p;
+}
 
-    if ( n > static_cast<size_t>( __MAX_BYTES ))
-        return std::malloc(n);
+void* alloc::allocate_typed(size_t n, const char* type)
+{
+    void* p = pool_allocate(n);
+    heap_profiler::on_allocate(p, n, type);
+    return p;
+}
+
+void  alloc::deallocate(void *p, size_t n)
+{
+    heap_profiler::on_deallocate(p);
+    pool_deallocate(p, n);
+}
+
+void* alloc::allocate_aligned(size_t n, size_t align, const char* type)
+{
+    void* p = pool_allocate_aligned(n, align);
+    heap_profiler::on_allocate(p, n, type);
+    return p;
+}
+
+void alloc::deallocate_aligned(void* p, size_t n, size_t align)
+{
+    heap_profiler::on_deallocate(p);
+    pool_deallocate_aligned(p, n, align);
+}
+
+void* alloc::allocate_batch(size_t n, size_t count, const char* type)
+{
+    void* result = pool_allocate_batch(n, count);
+    if ( heap_profiler::enabled() )
+        for ( obj* p = static_cast<obj*>(result); p != nullptr; p = p->next )
+            heap_profiler::on_allocate(p, n, type);
+    return result;
+}
+
+void* alloc::reallocate(void* p, size_t old_n, size_t new_n, const char* type)
+{
+    if ( nullptr == p )
+        return allocate_typed(new_n, type);
+    if ( old_n > static_cast<size_t>(__MAX_MEDIUM_BYTES) && new_n > static_cast<size_t>(__MAX_MEDIUM_BYTES) )
+    {
+        heap_profiler::on_deallocate(p);
+        void* result = std::realloc(p, new_n);
+        if ( nullptr == result )
+            throw std::bad_alloc();
+        large_allocations.fetch_add(1, std::memory_order_relaxed);
+        large_frees.fetch_add(1, std::memory_order_relaxed);
+        large_bytes.fetch_add(new_n, std::memory_order_relaxed);
+        heap_profiler::on_allocate(result, new_n, type);
+        return result;
+    }
+    // 新旧大小属于同一级时不用动
+    if ( old_n <= static_cast<size_t>(__MAX_MEDIUM_BYTES) && new_n <= static_cast<size_t>(__MAX_MEDIUM_BYTES)
+         && Freelist_index(old_n) == Freelist_index(new_n) )
+        return p;
+    void* result = allocate_typed(new_n, type);
+    std::memcpy(result, p, old_n < new_n ? old_n : new_n);
+    deallocate(p, old_n);
+    return result;
+}
 
-    if (  nullptr  == *current_free_list )                    // 若该链表下为空
+void* alloc::pool_allocate(size_t n)
+{
+    if ( n > static_cast<size_t>( __MAX_MEDIUM_BYTES ))
     {
-        void* r = refill(Round_up(n));
-        return r;
+        large_allocations.fetch_add(1, std::memory_order_relaxed);
+        large_bytes.fetch_add(n, std::memory_order_relaxed);
+        return std::malloc(n);
     }
 
-    // 不为空
-    result = *current_free_list;
-    *current_free_list = result->next;
+    size_t index = Freelist_index(n);
+    ++tcache.alloc_count[index];
+    obj* result = tcache.free_list[index];
+
+    if ( nullptr == result )                    // 若线程缓存为空，则去中心链表取一批
+        return fetch_from_central(tcache, Class_size(index));
+
+    // 不为空，直接从线程缓存取，无需同步
+    tcache.free_list[index] = result->next;
+    --tcache.length[index];
     return result;
 }
 
-void  alloc::deallocate(void *p, size_t n)
+void alloc::pool_deallocate(void *p, size_t n)
 {
-    if ( n > static_cast<size_t>(__MAX_BYTES) )
+    if ( n > static_cast<size_t>(__MAX_MEDIUM_BYTES) )
     {
+        large_frees.fetch_add(1, std::memory_order_relaxed);
         std::free(p);
         return;
     }
+    size_t index = Freelist_index(n);
+    ++tcache.free_count[index];
     obj * free = reinterpret_cast<obj*>( p );
-    obj ** current_free_list = free_list + Freelist_index(n);
-    free->next = *current_free_list;
-    *current_free_list = free;
+    free->next = tcache.free_list[index];
+    tcache.free_list[index] = free;
+
+    // 线程缓存过长时，归还一批给中心链表，留给其他线程使用
+    // 说明这一级的供给多于需求，同时把 refill 的个数减半
+    if ( ++tcache.length[index] > Max_cache_length(tcache, index) )
+    {
+        release_to_central(tcache, index, Batch_num(Class_size(index)));
+        if ( tcache.refill_num[index] > static_cast<size_t>(__MIN_REFILL) )
+            tcache.refill_num[index] /= 2;
+    }
+}
+
+void* alloc::pool_allocate_aligned(size_t n, size_t align)
+{
+    if ( align <= static_cast<size_t>(__ALIGN) )
+        return pool_allocate(n);
+    // 大小为 16 倍数的各级都按 16 字节切分，取整到 16 的倍数即可
+    if ( align <= static_cast<size_t>(__MEDIUM_ALIGN) )
+        return pool_allocate( Round_up_medium(n) );
+    // raw 至少按 8 字节对齐，返回地址与 raw 之间至少留出一个指针，至多 align 字节
+    // 大对象同样从 malloc 多要 align 字节，不依赖 C++17 的 aligned_alloc
+    char* raw;
+    if ( n + align > static_cast<size_t>(__MAX_MEDIUM_BYTES) )
+    {
+        large_allocations.fetch_add(1, std::memory_order_relaxed);
+        large_bytes.fetch_add(n, std::memory_order_relaxed);
+        raw = static_cast<char*>( std::malloc(n + align) );
+        if ( nullptr == raw )
+            throw std::bad_alloc();
+    }
+    else
+        raw = static_cast<char*>( pool_allocate(n + align) );
+    char* result = reinterpret_cast<char*>( (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + align - 1)
+                                            & ~static_cast<uintptr_t>(align - 1) );
+    reinterpret_cast<void**>(result)[-1] = raw;
+    return result;
+}
+
+void alloc::pool_deallocate_aligned(void* p, size_t n, size_t align)
+{
+    if ( align <= static_cast<size_t>(__ALIGN) )
+        pool_deallocate(p, n);
+    else if ( align <= static_cast<size_t>(__MEDIUM_ALIGN) )
+        pool_deallocate(p, Round_up_medium(n));
+    else if ( n + align > static_cast<size_t>(__MAX_MEDIUM_BYTES) )
+    {
+        large_frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(static_cast<void**>(p)[-1]);
+    }
+    else
+        pool_deallocate(static_cast<void**>(p)[-1], n + align);
+}
+
+void* alloc::pool_allocate_batch(size_t n, size_t count)
+{
+    if ( 0 == count )
+        return nullptr;
+    obj* result = nullptr;
+    if ( n > static_cast<size_t>( __MAX_MEDIUM_BYTES ))
+    {
+        large_allocations.fetch_add(count, std::memory_order_relaxed);
+        large_bytes.fetch_add(n * count, std::memory_order_relaxed);
+        for ( size_t i = 0; i != count; ++i )
+        {
+            obj* p = static_cast<obj*>( std::malloc(n) );
+            if ( nullptr == p )
+            {
+                for ( obj* next; result != nullptr; result = next )
+                {
+                    next = result->next;
+                    std::free(result);
+                }
+                throw std::bad_alloc();
+            }
+            p->next = result;
+            result = p;
+        }
+        return result;
+    }
+
+    size_t index = Freelist_index(n);
+    size_t size = Class_size(index);
+    tcache.alloc_count[index] += count;
+
+    // 先从线程缓存摘下一段
+    size_t got = 0;
+    obj* first = tcache.free_list[index];
+    if ( nullptr != first )
+    {
+        obj* last = first;
+        got = 1;
+        while ( got < count && last->next != nullptr )
+        {
+            last = last->next;
+            ++got;
+        }
+        tcache.free_list[index] = last->next;
+        tcache.length[index] -= got;
+        last->next = nullptr;
+        result = first;
+        if ( got == count )
+            return result;
+    }
+
+    // 再从中心链表取
+    register_thread_cache();
+    size_t central = 0;
+    for ( ; got < count; ++got, ++central )
+    {
+        obj* p = free_list[index].pop();
+        if ( nullptr == p )
+            break;
+        p->next = result;
+        result = p;
+    }
+    if ( 0 != central )
+        ++tcache.central_hit_count[index];
+
+    // 剩下的直接从内存块连续切出，每次至多一个内存块的大小
+    size_t max_num = __MAX_SPAN_BYTES / size;
+    while ( got < count )
+    {
+        int nobjs = static_cast<int>( count - got < max_num ? count - got : max_num );
+        char* start = chunk_alloc(size, nobjs);
+        ++tcache.refill_count[index];
+        for ( int i = nobjs - 1; i >= 0; --i )
+        {
+            obj* p = reinterpret_cast<obj*>(start + i * size);
+            p->next = result;
+            result = p;
+        }
+        got += nobjs;
+    }
+    return result;
+}
+
+void alloc::deallocate_batch(void* first, void* last, size_t n, size_t count)
+{
+    if ( nullptr == first || 0 == count )
+        return;
+    if ( heap_profiler::has_samples() )
+    {
+        obj* p = static_cast<obj*>(first);
+        for ( size_t i = 0; i != count; ++i, p = p->next )
+            heap_profiler::on_deallocate(p);
+    }
+    if ( n > static_cast<size_t>(__MAX_MEDIUM_BYTES) )
+    {
+        large_frees.fetch_add(count, std::memory_order_relaxed);
+        obj* p = static_cast<obj*>(first);
+        for ( size_t i = 0; i != count; ++i )
+        {
+            obj* next = p->next;
+            std::free(p);
+            p = next;
+        }
+        return;
+    }
+    size_t index = Freelist_index(n);
+    tcache.free_count[index] += count;
+    static_cast<obj*>(last)->next = tcache.free_list[index];
+    tcache.free_list[index] = static_cast<obj*>(first);
+
+    // 超出的部分一次归还给中心链表，线程缓存中留下一批
+    size_t batch = Batch_num(Class_size(index));
+    tcache.length[index] += count;
+    if ( tcache.length[index] > Max_cache_length(tcache, index) )
+        release_to_central(tcache, index, tcache.length[index] - batch);
+}
+
+void* alloc::fetch_from_central(thread_cache& cache, size_t n)
+{
+    register_thread_cache();
+
+    size_t index = Freelist_index(n);
+    obj* result = free_list[index].pop();
+    if ( nullptr == result )
+        return refill(cache, n);
+    ++cache.central_hit_count[index];
+
+    // 再从中心链表弹出至多 num-1 个对象放入线程缓存
+    size_t num = Batch_num(n);
+    for ( size_t count = 1; count < num; ++count )
+    {
+        obj* p = free_list[index].pop();
+        if ( nullptr == p )
+            break;
+        p->next = cache.free_list[index];
+        cache.free_list[index] = p;
+        ++cache.length[index];
+    }
+    return result;
+}
+
+void alloc::release_to_central(thread_cache& cache, size_t index, size_t num)
+{
+    obj* first = cache.free_list[index];
+    if ( nullptr == first || 0 == num )
+        return;
+    register_thread_cache();
+    // 先在本线程内找到这一批的尾部，再一次 CAS 压入中心链表
+    obj* last = first;
+    size_t count = 1;
+    while ( count < num && last->next != nullptr )
+    {
+        last = last->next;
+        ++count;
+    }
+    cache.free_list[index] = last->next;
+    cache.length[index] -= count;
+    free_list[index].push(first, last, count);
+}
+
+void alloc::flush_thread_cache()
+{
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
+        release_to_central(tcache, i, tcache.length[i]);
 }
 
-void* alloc::refill(size_t n)
+void* alloc::refill(thread_cache& cache, size_t n)
 {
-    int nobjs = 20;
+    size_t index = Freelist_index(n);
+    ++cache.refill_count[index];
+
+    // 慢启动：冷门的链表每次只切几个，频繁 refill 的链表每次翻倍，直到上限
+    size_t& num = cache.refill_num[index];
+    if ( num < static_cast<size_t>(__MIN_REFILL) )
+        num = __MIN_REFILL;
+    int nobjs = static_cast<int>(num);
+    size_t max_num = Max_refill_num(n);
+    num = num * 2 > max_num ? max_num : num * 2;
+
     char * chunk = chunk_alloc(n, nobjs );
     if ( 1 == nobjs )
         return chunk;
-    obj** current_free_list = free_list + Freelist_index(n);
 
-    obj* current_obj, * next_obj;
+    // 除第一个之外，其余对象串成链表挂到线程缓存
+    obj* first = reinterpret_cast<obj*>(chunk + n);
+    obj* current_obj = first;
+    for ( int i = 2; i != nobjs; ++i )
+    {
+        obj* next_obj = reinterpret_cast<obj*>( reinterpret_cast<char*>(current_obj) + n );
+        current_obj->next = next_obj;
+        current_obj = next_obj;
+    }
+    current_obj->next = cache.free_list[index];
+    cache.free_list[index] = first;
+    cache.length[index] += nobjs - 1;
+    return chunk;
+}
+
+char* alloc::chunk_alloc(size_t size, int &nobjs)
+{
+    chunk_alloc_calls.fetch_add(1, std::memory_order_relaxed);
+    for (;;)
+    {
+        chunk* c = current_chunk.load(std::memory_order_acquire);
+        if ( nullptr != c )
+        {
+            char* cur = c->cur.load(std::memory_order_relaxed);
+            // 中等对象和大小为 16 倍数的小对象按 16 字节对齐切分，跳过的 8 字节挂到最小的链表
+            char* start = size > static_cast<size_t>(__MAX_BYTES) || 0 == size % __MEDIUM_ALIGN
+                    ? reinterpret_cast<char*>( (reinterpret_cast<uintptr_t>(cur) + __MEDIUM_ALIGN - 1)
+                                               & ~static_cast<uintptr_t>(__MEDIUM_ALIGN - 1) )
+                    : cur;
+            size_t pool_left_bytes = start <= c->end ? c->end - start : 0;
+            if ( pool_left_bytes >= size )
+            {
+                // 剩余内存足够至少一个对象，则尽量多切
+                size_t num = pool_left_bytes / size;
+                if ( num > static_cast<size_t>(nobjs) )
+                    num = nobjs;
+                if ( c->cur.compare_exchange_weak(cur, start + size * num, std::memory_order_relaxed) )
+                {
+                    if ( start != cur )
+                        free_list[0].push(reinterpret_cast<obj*>(cur), reinterpret_cast<obj*>(cur), 1);
+                    nobjs = static_cast<int>(num);
+                    return start;
+                }
+                continue;
+            }
+        }
+        grow_pool(c, size * nobjs);
+    }
+}
+
+void alloc::grow_pool(chunk* old, size_t total_bytes)
+{
+    std::lock_guard<std::mutex> guard(grow_lock);
+    // 其他线程已经换上了新的内存块
+    if ( current_chunk.load(std::memory_order_relaxed) != old )
+        return;
+
+    // 把旧内存块剩下的零头收走，挂到合适的中心链表
+    if ( nullptr != old )
+    {
+        char* cur = old->cur.exchange(old->end, std::memory_order_relaxed);
+        // 先切掉不足 16 字节对齐的 8 字节，使挂到 16 倍数链表上的零头同样按 16 字节对齐
+        if ( cur != old->end && 0 != reinterpret_cast<uintptr_t>(cur) % __MEDIUM_ALIGN )
+        {
+            obj* p = reinterpret_cast<obj*>(cur);
+            free_list[0].push(p, p, 1);
+            cur += __ALIGN;
+        }
+        while ( cur != old->end )
+        {
+            size_t bytes = old->end - cur;
+            if ( bytes > static_cast<size_t>(__MAX_BYTES) )
+                bytes = __MAX_BYTES;
+            obj* p = reinterpret_cast<obj*>(cur);
+            free_list[Freelist_index(bytes)].push(p, p, 1);
+            cur += bytes;
+        }
+    }
+
+    // 索要的内存大小由下式决定，另留出对齐的余量，按页面来源的粒度取整
+    page_source* source = get_page_source();
+    size_t granularity = source->granularity();
+    size_t max_span = std::max(static_cast<size_t>(__MAX_SPAN_BYTES), granularity);
+    size_t byte_to_get = 2 * total_bytes + Round_up(heap_size >> 4 ) + __MEDIUM_ALIGN;
+    if ( byte_to_get > max_span )
+        byte_to_get = std::max(max_span, total_bytes + __MEDIUM_ALIGN);
+    byte_to_get = (byte_to_get + granularity - 1) & ~(granularity - 1);
 
-    *current_free_list = current_obj = reinterpret_cast<obj*>(chunk + n);
+    // 优先复用已经归还给系统的内存块
+    chunk* c = nullptr;
+    for ( chunk* p = all_chunks; p != nullptr; p = p->next )
+        if ( p->released && static_cast<size_t>(p->end - p->begin) >= byte_to_get )
+        {
+            c = p;
+            break;
+        }
 
-    for ( int i = 0; i != nobjs-1; ++i )
+    if ( nullptr != c )
+        c->released = false;
+    else
     {
-        if ( i == 18 )
-            current_obj->next = nullptr;
-        else
+        void* start = source->allocate(byte_to_get);
+        if ( nullptr == start )
         {
-            next_obj = reinterpret_cast<obj*>( reinterpret_cast<char*>(current_obj) + n) ;
-            current_obj->next = next_obj;
-            current_obj = next_obj;
+            std::cerr <<"out of memory" << std::endl;
+            throw std::bad_alloc();
         }
+        system_bytes.fetch_add(byte_to_get, std::memory_order_relaxed);
+        c = new chunk;
+        c->begin = static_cast<char*>(start);
+        c->end = c->begin + byte_to_get;
+        c->source = source;
+        c->released = false;
+        c->next = all_chunks;
+        all_chunks = c;
     }
-    return chunk;
+
+    heap_size += c->end - c->begin;
+    c->cur.store(c->begin, std::memory_order_relaxed);
+    current_chunk.store(c, std::memory_order_release);
 }
 
-char* alloc::chunk_alloc(size_t size, int &nobjs)
+size_t alloc::trim()
 {
-    size_t total_bytes = size * nobjs;
-    size_t pool_left_bytes = end_pool - start_pool;
-    char* result;
+    flush_thread_cache();
+    std::lock_guard<std::mutex> guard(grow_lock);
+
+    // 正在切分的内存块不参与归还，其余按地址排序以便查找对象所属的内存块
+    struct span_usage{
+        chunk* c;
+        size_t free_bytes;
+        bool operator<(const span_usage& x) const { return c->begin < x.c->begin; }
+    };
+    chunk* current = current_chunk.load(std::memory_order_relaxed);
+    std::vector<span_usage> spans;
+    for ( chunk* c = all_chunks; c != nullptr; c = c->next )
+        if ( !c->released && c != current )
+            spans.push_back( span_usage{c, 0} );
+    if ( spans.empty() )
+        return 0;
+    std::sort(spans.begin(), spans.end());
 
-    if ( pool_left_bytes > total_bytes )
+    auto find_span = [&spans](obj* p) -> span_usage* {
+        char* addr = reinterpret_cast<char*>(p);
+        size_t lo = 0, hi = spans.size();
+        while ( lo < hi )
+        {
+            size_t mid = (lo + hi) / 2;
+            if ( spans[mid].c->begin <= addr )
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if ( 0 == lo || addr >= spans[lo - 1].c->end )
+            return nullptr;
+        return &spans[lo - 1];
+    };
+
+    // 取走全部中心链表，统计每个内存块中空闲的字节数
+    // 其他线程此时看到的是空链表，会从内存池切新的对象，不受影响
+    obj* lists[ __NUM_SIZE_CLASS ];
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
     {
-        result = start_pool;
-        start_pool += total_bytes;
-        return result;
+        lists[i] = free_list[i].take_all();
+        long count = 0;
+        for ( obj* p = lists[i]; p != nullptr; p = p->next, ++count )
+            if ( span_usage* span = find_span(p) )
+                span->free_bytes += Class_size(i);
+        free_list[i].length.fetch_sub(count, std::memory_order_relaxed);
     }
-    else if ( pool_left_bytes >= size )
+
+    // 已切出的内存全部空闲的内存块，把物理内存还给系统
+    // 只归还物理内存而不解除映射，因为其他线程的 pop 可能仍在读取旧的链表节点，地址必须保持有效
+    size_t released = 0;
+    for ( span_usage& span : spans )
     {
-        result = start_pool;
-        nobjs = pool_left_bytes/size;
-        total_bytes = size * nobjs;
-        start_pool += total_bytes;
-        return result;
+        chunk* c = span.c;
+        size_t carved = c->cur.load(std::memory_order_relaxed) - c->begin;
+        if ( 0 != carved && span.free_bytes == carved )
+        {
+            c->source->decommit(c->begin, c->end - c->begin);
+            c->released = true;
+            heap_size -= c->end - c->begin;
+            released += c->end - c->begin;
+        }
     }
-    else
+    released_bytes.fetch_add(released, std::memory_order_relaxed);
+
+    // 其余对象放回中心链表
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
     {
-        if ( pool_left_bytes > 0 )
+        obj* first = nullptr;
+        obj* last = nullptr;
+        size_t count = 0;
+        for ( obj* p = lists[i], *next; p != nullptr; p = next )
         {
-            obj** current_free_list = free_list + Freelist_index(pool_left_bytes);
-            (reinterpret_cast<obj*>(start_pool))->next = *current_free_list;
-            *current_free_list = reinterpret_cast<obj*>(start_pool);
+            next = p->next;
+            span_usage* span = find_span(p);
+            if ( span != nullptr && span->c->released )
+                continue;
+            p->next = first;
+            first = p;
+            if ( nullptr == last )
+                last = p;
+            ++count;
         }
-        // 索要的内存大小由下式决定
-        size_t byte_to_get = 2 * total_bytes + Round_up(heap_size >> 4 );
-        start_pool = static_cast<char*>(malloc(byte_to_get));
+        if ( nullptr != first )
+            free_list[i].push(first, last, count);
+    }
+    return released;
+}
+
+void alloc::trim_loop()
+{
+    for (;;)
+    {
+        long interval = trim_interval_ms.load(std::memory_order_relaxed);
+        std::this_thread::sleep_for( std::chrono::milliseconds(interval > 0 ? interval : 1000) );
+        if ( trim_interval_ms.load(std::memory_order_relaxed) > 0 )
+            trim();
+    }
+}
+
+void alloc::set_trim_interval(std::chrono::milliseconds interval)
+{
+    static std::once_flag started;
+    trim_interval_ms.store(static_cast<long>(interval.count()), std::memory_order_relaxed);
+    if ( interval.count() > 0 )
+        std::call_once(started, []{ std::thread(trim_loop).detach(); });
+}
+
+void alloc::register_thread_cache()
+{
+    if ( tcache.registered || tcache.exited )
+        return;
+    // 同时注册线程退出时的清理
+    static thread_local thread_cache_cleaner cleaner;
+    (void)cleaner;
+    std::lock_guard<std::mutex> guard(stats_lock);
+    tcache.next_cache = all_caches;
+    all_caches = &tcache;
+    tcache.registered = true;
+}
+
+void alloc::unregister_thread_cache()
+{
+    std::lock_guard<std::mutex> guard(stats_lock);
+    tcache.exited = true;
+    if ( !tcache.registered )
+        return;
+    for ( thread_cache** p = &all_caches; *p != nullptr; p = &(*p)->next_cache )
+        if ( *p == &tcache )
+        {
+            *p = tcache.next_cache;
+            break;
+        }
+    tcache.registered = false;
+    // 退出线程的计数并入 exited_caches
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
+    {
+        exited_caches.alloc_count[i] += tcache.alloc_count[i];
+        exited_caches.free_count[i] += tcache.free_count[i];
+        exited_caches.central_hit_count[i] += tcache.central_hit_count[i];
+        exited_caches.refill_count[i] += tcache.refill_count[i];
+    }
+}
+
+void alloc::collect_stats(const thread_cache& cache, alloc_stats& result)
+{
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
+    {
+        alloc_stats::size_class& sc = result.classes[i];
+        sc.allocations += cache.alloc_count[i];
+        sc.frees += cache.free_count[i];
+        sc.central_hits += cache.central_hit_count[i];
+        sc.refills += cache.refill_count[i];
+        sc.idle_bytes += cache.length[i] * sc.size;
+    }
+}
+
+alloc_stats alloc::global_stats()
+{
+    alloc_stats result = alloc_stats();
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
+    {
+        result.classes[i].size = Class_size(i);
+        long length = free_list[i].length.load(std::memory_order_relaxed);
+        result.classes[i].idle_bytes = length > 0 ? length * Class_size(i) : 0;
+    }
+    result.chunk_alloc_calls = chunk_alloc_calls.load(std::memory_order_relaxed);
+    result.system_bytes = system_bytes.load(std::memory_order_relaxed);
+    result.released_bytes = released_bytes.load(std::memory_order_relaxed);
+    result.heap_size = heap_size.load(std::memory_order_relaxed);
+    result.large_allocations = large_allocations.load(std::memory_order_relaxed);
+    result.large_frees = large_frees.load(std::memory_order_relaxed);
+    result.large_bytes = large_bytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+void alloc::summarize_stats(alloc_stats& result)
+{
+    result.idle_bytes = 0;
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
+    {
+        alloc_stats::size_class& sc = result.classes[i];
+        uint64_t misses = sc.central_hits + sc.refills;
+        sc.cache_hits = sc.allocations > misses ? sc.allocations - misses : 0;
+        result.idle_bytes += sc.idle_bytes;
+    }
+}
+
+alloc_stats alloc::stats()
+{
+    alloc_stats result = global_stats();
+    {
+        std::lock_guard<std::mutex> guard(stats_lock);
+        collect_stats(exited_caches, result);
+        for ( thread_cache* cache = all_caches; cache != nullptr; cache = cache->next_cache )
+            collect_stats(*cache, result);
+        // 尚未登记的当前线程
+        if ( !tcache.registered )
+            collect_stats(tcache, result);
+    }
+    summarize_stats(result);
+    return result;
+}
+
+void alloc::write_stats(int fd, const alloc_stats& result, bool per_thread)
+{
+    // 不能使用 printf 一类的函数，手工格式化后用 write 输出
+    struct writer{
+        int fd;
+        char buf[256];
+        size_t len;
 
-        if ( 0 == start_pool )
+        void flush() { if ( len != 0 && ::write(fd, buf, len) < 0 ) {} len = 0; }
+        writer& operator<<(const char* str)
         {
-            int i ;
-            obj** current_free_list;
-            obj* p;
-            for (i = size +__ALIGN; i < __MAX_BYTES; i+= __ALIGN )
+            for ( ; *str != '\0'; ++str )
             {
-                current_free_list = free_list + Freelist_index(i);
-                p = *current_free_list;
-                if ( p != nullptr )
-                {
-                    *current_free_list = p->next;
-                    start_pool = reinterpret_cast<char*>(p);
-                    end_pool = start_pool + i;
-                    return chunk_alloc(size,nobjs);
-                }
+                if ( len == sizeof(buf) )
+                    flush();
+                buf[len++] = *str;
             }
-            end_pool = nullptr;
-            std::cerr <<"out of memory" << std::endl;
-            throw std::bad_alloc();
+            return *this;
         }
+        writer& operator<<(uint64_t n)
+        {
+            char digits[24];
+            char* p = digits + sizeof(digits);
+            *--p = '\0';
+            do{
+                *--p = static_cast<char>('0' + n % 10);
+                n /= 10;
+            }while ( n != 0 );
+            return *this << p;
+        }
+    };
+
+    writer out{ fd, {}, 0 };
+    out << "MySTL::alloc stats" << (per_thread ? "\n" : " (per-thread counts omitted)\n");
+    out << "heap_size: " << static_cast<uint64_t>(result.heap_size) << "\n";
+    out << "system_bytes: " << result.system_bytes << "\n";
+    out << "released_bytes: " << result.released_bytes << "\n";
+    out << "chunk_alloc_calls: " << result.chunk_alloc_calls << "\n";
+    out << "large_allocations: " << result.large_allocations
+        << " large_frees: " << result.large_frees
+        << " large_bytes: " << result.large_bytes << "\n";
+    out << "size allocations frees cache_hits central_hits refills idle_bytes\n";
+    for ( size_t i = 0; i != __NUM_SIZE_CLASS; ++i )
+    {
+        const alloc_stats::size_class& sc = result.classes[i];
+        if ( 0 == sc.allocations && 0 == sc.frees && 0 == sc.idle_bytes )
+            continue;
+        out << static_cast<uint64_t>(sc.size) << " " << sc.allocations << " " << sc.frees << " "
+            << sc.cache_hits << " " << sc.central_hits << " " << sc.refills << " "
+            << static_cast<uint64_t>(sc.idle_bytes) << "\n";
+    }
+    out << "idle_bytes: " << static_cast<uint64_t>(result.idle_bytes) << "\n";
+    out.flush();
+}
+
+void alloc::dump_stats(int fd)
+{
+    write_stats(fd, stats(), true);
+}
 
-        heap_size += byte_to_get;
-        end_pool = start_pool + byte_to_get;
-        return chunk_alloc(size, nobjs);
-     }
+void alloc::stats_signal_handler(int)
+{
+    // 信号可能打断持有 stats_lock 的线程，这里只读取原子计数，不碰锁和线程缓存链表
+    alloc_stats result = global_stats();
+    summarize_stats(result);
+    write_stats(STDERR_FILENO, result, false);
+}
+
+void alloc::install_stats_signal(int sig)
+{
+    std::signal(sig, stats_signal_handler);
 }
 
 // 定义 allocator 的一个公有接口
@@ -191,16 +1161,93 @@ public:
     typedef ptrdiff_t     ptrdiff_type;
 
 public:
-    static T* allocate(size_t n) { return 0 == n? 0 : reinterpret_cast<T*>( Alloc::allocate( n*sizeof(T) )) ; }
-    static T* allocate() { return reinterpret_cast<T*>(  Alloc::allocate( sizeof(T) )); }
-    static void deallocate(T* p, size_t n ) { if (0 != n) Alloc::deallocate( p, n*sizeof(T) ); }
-    static void deallocate(T* p) { Alloc::deallocate(p, sizeof(T)); }
+    // 没有状态，所有实例都相等，容器中保存的实例不占额外的信息
+    pool_allocator() {}
+    template <class U>
+    pool_allocator(const pool_allocator<U, Alloc>&) {}
+
+private:
+    // T 的对齐要求超过内存池的默认保证时，走 allocate_aligned
+    static bool over_aligned() { return alignof(T) > static_cast<size_t>(__ALIGN); }
+
+public:
+    static T* allocate(size_t n)
+    {
+        if ( 0 == n )
+            return 0;
+        if ( over_aligned() )
+            return reinterpret_cast<T*>( Alloc::allocate_aligned( n*sizeof(T), alignof(T), heap_type_name<T>() ));
+        return reinterpret_cast<T*>( Alloc::allocate_typed( n*sizeof(T), heap_type_name<T>() ));
+    }
+    static T* allocate() { return allocate(1); }
+    static void deallocate(T* p, size_t n )
+    {
+        if ( 0 == n )
+            return;
+        if ( over_aligned() )
+            Alloc::deallocate_aligned( p, n*sizeof(T), alignof(T) );
+        else
+            Alloc::deallocate( p, n*sizeof(T) );
+    }
+    static void deallocate(T* p) { deallocate(p, 1); }
+
+    // 申请 n 个对象时实际可以放下的对象个数，按这个个数分配和释放都落在同一块内存上
+    // 需要额外对齐的类型走 allocate_aligned，没有可用的余量
+    static size_t usable_size(size_t n)
+    {
+        if ( 0 == n || over_aligned() )
+            return n;
+        return Alloc::usable_size( n*sizeof(T) ) / sizeof(T);
+    }
+
+    // 把 old_n 个对象的 p 调整为 new_n 个对象，按字节搬移，只能用于 is_trivially_relocatable 的类型
+    static T* reallocate(T* p, size_t old_n, size_t new_n)
+    {
+        if ( !over_aligned() )
+            return static_cast<T*>( Alloc::reallocate( p, old_n*sizeof(T), new_n*sizeof(T), heap_type_name<T>() ));
+        T* result = allocate(new_n);
+        if ( nullptr != p )
+        {
+            std::memcpy(static_cast<void*>(result), p, (old_n < new_n ? old_n : new_n) * sizeof(T));
+            deallocate(p, old_n);
+        }
+        return result;
+    }
+
+    // 一次分配 count 个对象，串成的链表用 batch_next() 遍历
+    static T* allocate_batch(size_t count)
+    {
+        if ( !over_aligned() )
+            return static_cast<T*>( Alloc::allocate_batch( sizeof(T), count, heap_type_name<T>() ));
+        T* head = nullptr;
+        for ( size_t i = 0; i != count; ++i )
+        {
+            T* p = allocate(1);
+            *reinterpret_cast<T**>(p) = head;
+            head = p;
+        }
+        return head;
+    }
+    static void deallocate_batch(T* first, T* last, size_t count)
+    {
+        if ( !over_aligned() )
+        {
+            Alloc::deallocate_batch( first, last, sizeof(T), count );
+            return;
+        }
+        for ( size_t i = 0; i != count; ++i )
+        {
+            T* next = *reinterpret_cast<T**>(first);
+            deallocate(first, 1);
+            first = next;
+        }
+    }
 
 public:
     template <class U>
     struct rebind
     {
-        typedef pool_allocator<U> other;
+        typedef pool_allocator<U, Alloc> other;
     };
 
 public:
@@ -212,6 +1259,98 @@ public:
 
 };
 
+template <class T, class U, class Alloc>
+inline bool operator==(const pool_allocator<T, Alloc>&, const pool_allocator<U, Alloc>&) { return true; }
+template <class T, class U, class Alloc>
+inline bool operator!=(const pool_allocator<T, Alloc>&, const pool_allocator<U, Alloc>&) { return false; }
+
+// 批量分配的对象尚未构造，通过开头的一个指针串成单链表，以下两个函数读写这个指针
+template <class T>
+inline T* batch_next(T* p) { return *reinterpret_cast<T**>(p); }
+template <class T>
+inline void batch_link(T* p, T* next) { *reinterpret_cast<T**>(p) = next; }
+
+// 分配器提供 allocate_batch 时一次取出 count 个对象，否则逐个分配后串成链表
+template <class Allocator>
+inline auto _batch_allocate(Allocator& a, size_t count, int) -> decltype( a.allocate_batch(count) )
+{ return a.allocate_batch(count); }
+
+template <class Allocator>
+inline typename Allocator::pointer _batch_allocate(Allocator& a, size_t count, long)
+{
+    typename Allocator::pointer head = nullptr;
+    for ( size_t i = 0; i != count; ++i )
+    {
+        typename Allocator::pointer p = a.allocate(1);
+        batch_link(p, head);
+        head = p;
+    }
+    return head;
+}
+
+template <class Allocator>
+inline typename Allocator::pointer batch_allocate(Allocator& a, size_t count)
+{ return _batch_allocate(a, count, 0); }
+
+// 归还 first 到 last 串成的 count 个对象，分配器不支持时逐个归还
+template <class Allocator>
+inline auto _batch_deallocate(Allocator& a, typename Allocator::pointer first,
+                              typename Allocator::pointer last, size_t count, int)
+    -> decltype( a.deallocate_batch(first, last, count) )
+{ return a.deallocate_batch(first, last, count); }
+
+template <class Allocator>
+inline void _batch_deallocate(Allocator& a, typename Allocator::pointer first,
+                              typename Allocator::pointer, size_t count, long)
+{
+    for ( size_t i = 0; i != count; ++i )
+    {
+        typename Allocator::pointer next = batch_next(first);
+        a.deallocate(first, 1);
+        first = next;
+    }
+}
+
+// 按字节把 old_n 个对象搬到 new_n 个对象的空间，分配器提供 reallocate 时可能原地扩展
+template <class Allocator>
+inline auto _allocator_reallocate(Allocator& a, typename Allocator::pointer p, size_t old_n, size_t new_n, int)
+    -> decltype( a.reallocate(p, old_n, new_n) )
+{ return a.reallocate(p, old_n, new_n); }
+
+template <class Allocator>
+inline typename Allocator::pointer
+_allocator_reallocate(Allocator& a, typename Allocator::pointer p, size_t old_n, size_t new_n, long)
+{
+    typename Allocator::pointer result = a.allocate(new_n);
+    if ( nullptr != p )
+    {
+        std::memcpy(static_cast<void*>(result), p, (old_n < new_n ? old_n : new_n) * sizeof(*p));
+        a.deallocate(p, old_n);
+    }
+    return result;
+}
+
+template <class Allocator>
+inline typename Allocator::pointer
+allocator_reallocate(Allocator& a, typename Allocator::pointer p, size_t old_n, size_t new_n)
+{ return _allocator_reallocate(a, p, old_n, new_n, 0); }
+
+// 申请 n 个对象时分配器实际给出的对象个数，分配器没有 usable_size 时就是 n
+template <class Allocator>
+inline auto _allocator_usable_size(const Allocator& a, size_t n, int) -> decltype( a.usable_size(n) )
+{ return a.usable_size(n); }
+
+template <class Allocator>
+inline size_t _allocator_usable_size(const Allocator&, size_t n, long) { return n; }
+
+template <class Allocator>
+inline size_t allocator_usable_size(const Allocator& a, size_t n) { return _allocator_usable_size(a, n, 0); }
+
+template <class Allocator>
+inline void batch_deallocate(Allocator& a, typename Allocator::pointer first,
+                             typename Allocator::pointer last, size_t count)
+{ _batch_deallocate(a, first, last, count, 0); }
+
 
 } // end of namespace MySTL
 #endif // POOL_ALLOCATOR_H
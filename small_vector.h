@@ -0,0 +1,295 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+// 这个文件是 small_vector 的头文件
+// small_vector<T, N> 的前 N 个元素存放在对象内部，不分配内存，超过 N 个之后才向分配器申请空间
+// 接口与 vector 相同，适合绝大多数时候只有几个元素的场合
+#include "pool_allocator.h"
+#include "uninitialized.h"
+#include "construct.h"
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+
+namespace MySTL {
+
+template<class T, size_t N, class Alloc = pool_allocator<T> >
+class small_vector{
+
+public:
+    typedef  T*             iterator;
+    typedef  const T*       const_iterator;
+    typedef  T              value_type;
+    typedef  T*             pointer;
+    typedef  const T*       const_pointer;
+    typedef  T&             reference;
+    typedef  const T&       const_reference;
+    typedef  size_t         size_type;
+    typedef  ptrdiff_t      difference_type;
+    typedef  Alloc          allocator_type;
+
+    static constexpr size_type inline_capacity = N;
+
+private:
+    pointer _start;
+    pointer _finish;
+    pointer _end_of_storage;
+    Alloc   _alloc;
+    // 内部存储，未使用时不构造任何元素
+    alignas(T) unsigned char _buffer[ N == 0 ? 1 : N * sizeof(T) ];
+
+private:
+    pointer inline_data() { return reinterpret_cast<pointer>(_buffer); }
+    bool is_inline() const { return _start == reinterpret_cast<const_pointer>(_buffer); }
+    void init_inline() { _start = _finish = inline_data(); _end_of_storage = _start + N; }
+    void deallocate() { if ( !is_inline() ) _alloc.deallocate(_start, _end_of_storage - _start); }
+
+    // 换到至少能放下 new_cap 个元素的堆空间，元素按 vector 的规则移动或拷贝过去
+    void grow(size_type new_cap)
+    {
+        size_type old_size = size();
+        pointer new_start = _alloc.allocate(new_cap);
+        try{
+            MySTL::uninitialized_move_if_noexcept(_start,_finish,new_start);
+        }
+        catch(...){
+            _alloc.deallocate(new_start,new_cap);
+            throw;
+        }
+        destory(_start,_finish);
+        deallocate();
+        _start = new_start;
+        _finish = new_start + old_size;
+        _end_of_storage = new_start + new_cap;
+    }
+    // 再放 n 个元素时的新容量，按 2 倍增长
+    size_type next_capacity(size_type n) const
+    {
+        size_type len = capacity() * 2;
+        return len < size() + n ? size() + n : len;
+    }
+
+    // 接管 x 的元素：x 在堆上时直接接管内存，在内部存储时逐个移动
+    void steal(small_vector& x)
+    {
+        if ( x.is_inline() ){
+            init_inline();
+            _finish = MySTL::uninitialized_move(x._start,x._finish,_start);
+            destory(x._start,x._finish);
+        }
+        else{
+            _start = x._start;
+            _finish = x._finish;
+            _end_of_storage = x._end_of_storage;
+        }
+        x.init_inline();
+    }
+
+    template<class InputIterator>
+    void range_initialize(InputIterator first, InputIterator last, std::input_iterator_tag)
+    {
+        for ( ; first != last; ++first )
+            emplace_back(*first);
+    }
+    template<class ForwardIterator>
+    void range_initialize(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+    {
+        reserve( static_cast<size_type>(std::distance(first,last)) );
+        _finish = MySTL::uninitialized_copy(first,last,_start);
+    }
+
+public:
+    small_vector() { init_inline(); }
+    explicit small_vector(const Alloc& a): _alloc(a) { init_inline(); }
+    small_vector(size_type n,const value_type& value, const Alloc& a = Alloc()): _alloc(a)
+    {
+        init_inline();
+        reserve(n);
+        _finish = MySTL::uninitialized_fill_n(_start,n,value);
+    }
+    explicit small_vector(size_type n, const Alloc& a = Alloc()): small_vector(n, T(), a) {}
+    template<class InputIterator, class = typename std::iterator_traits<InputIterator>::iterator_category>
+    small_vector(InputIterator first,InputIterator last, const Alloc& a = Alloc()): _alloc(a)
+    {
+        init_inline();
+        range_initialize(first,last,typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+    small_vector(std::initializer_list<value_type> list, const Alloc& a = Alloc())
+        : small_vector(list.begin(), list.end(), a) {}
+    // 拷贝构造函数，分配器随之拷贝
+    small_vector(const small_vector& x): small_vector(x.cbegin(), x.cend(), x._alloc) {}
+    // 移动构造函数，x 在堆上时直接接管内存
+    small_vector(small_vector&& x) noexcept(std::is_nothrow_move_constructible<T>::value)
+        : _alloc(x._alloc)
+    { steal(x); }
+
+    ~small_vector() { destory(_start,_finish); deallocate(); }
+
+    small_vector& operator=(const small_vector& x)
+    {
+        if ( &x != this ){
+            small_vector temp(x);
+            swap(temp);
+        }
+        return *this;
+    }
+    small_vector& operator=(small_vector&& x) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        if ( &x != this ){
+            destory(_start,_finish);
+            deallocate();
+            _alloc = x._alloc;
+            steal(x);
+        }
+        return *this;
+    }
+
+public:
+    allocator_type get_allocator() const { return _alloc; }
+    iterator begin()  {return _start; }
+    const_iterator cbegin() const { return _start; }
+    const_iterator cend() const { return _finish; }
+    iterator end() { return _finish; }
+    size_type size() const { return static_cast<size_type>( _finish - _start ); }
+    size_type capacity()const { return static_cast<size_type>(_end_of_storage - _start) ; }
+    bool empty()const { return _start == _finish; }
+    // 元素是否仍在对象内部
+    bool is_small() const { return is_inline(); }
+    reference operator[](size_type n) { return *( _start + n ); }
+    const_reference operator[](size_type n)const { return *( _start + n ); }
+    reference front(){ return *_start; }
+    reference back(){ return *(_finish-1); }
+
+    // 插入末尾
+    void push_back(const_reference value) { emplace_back(value); }
+    void push_back(value_type&& value) { emplace_back(std::move(value)); }
+    template <class... Args>
+    reference emplace_back(Args&&... args)
+    {
+        if ( _finish == _end_of_storage ){
+            // args 可能引用容器中的元素，先构造出新值再扩容
+            value_type value_copy(std::forward<Args>(args)...);
+            grow(next_capacity(1));
+            construct(_finish, std::move(value_copy));
+        }
+        else
+            construct(_finish, std::forward<Args>(args)...);
+        ++_finish;
+        return back();
+    }
+    // 在 position 处直接用 args 构造元素，返回指向新元素的迭代器
+    template <class... Args>
+    iterator emplace(iterator position, Args&&... args)
+    {
+        size_type offset = position - _start;
+        if ( position == _finish ){
+            emplace_back(std::forward<Args>(args)...);
+            return _start + offset;
+        }
+        value_type value_copy(std::forward<Args>(args)...);
+        if ( _finish == _end_of_storage )
+            grow(next_capacity(1));
+        position = _start + offset;
+        construct(_finish, std::move(*(_finish - 1)));
+        ++_finish;
+        std::move_backward(position,_finish - 2,_finish - 1);
+        *position = std::move(value_copy);
+        return position;
+    }
+    // 在 position 处插入 n 个 value
+    void insert(iterator position,size_type n, value_type value)
+    {
+        if ( n == 0 )
+            return;
+        size_type offset = position - _start;
+        if ( capacity() - size() < n )
+            grow(next_capacity(n));
+        position = _start + offset;
+        size_type after = static_cast<size_type>(_finish - position);
+        if ( after > n ){
+            MySTL::uninitialized_move(_finish - n,_finish,_finish);
+            std::move_backward(position,_finish - n,_finish);
+            std::fill(position,position + n,value);
+        }
+        else{
+            MySTL::uninitialized_fill_n(_finish, n - after, value);
+            MySTL::uninitialized_move(position,_finish,position + n);
+            std::fill(position,_finish,value);
+        }
+        _finish += n;
+    }
+    void clear() { erase(_start,_finish); }
+
+    // 弹出末尾
+    value_type pop_back() { --_finish; value_type result = std::move(*_finish); destory(_finish); return result; }
+
+    iterator erase(iterator position){
+        std::move(position+1,_finish,position);
+        --_finish;
+        destory(_finish);
+        return position;
+    }
+    iterator erase(iterator first,iterator last)
+    {
+        iterator i = std::move(last,_finish,first);
+        destory(i,_finish);
+        _finish = i;
+        return first;
+    }
+
+    void resize(size_type n) { resize(n, value_type()); }
+    void resize(size_type n, const_reference value)
+    {
+        if ( n < size() ){
+            destory(_start+n,_finish);
+            _finish = _start+n;
+        }
+        else
+            insert(_finish, n - size(), value);
+    }
+    void reserve(size_type new_cap)
+    {
+        if ( new_cap > capacity() )
+            grow(new_cap);
+    }
+    // 元素已回到 N 个以内时搬回内部存储，释放堆空间
+    void shrink_to_fit()
+    {
+        if ( is_inline() || size() > N )
+            return;
+        pointer old_start = _start;
+        pointer old_finish = _finish;
+        size_type old_cap = capacity();
+        init_inline();
+        _finish = MySTL::uninitialized_move(old_start,old_finish,_start);
+        destory(old_start,old_finish);
+        _alloc.deallocate(old_start,old_cap);
+    }
+
+    void swap(small_vector& another)
+    {
+        if ( &another == this )
+            return;
+        // 都在堆上时只交换指针，否则借助一个临时对象逐个移动
+        if ( !is_inline() && !another.is_inline() ){
+            std::swap(_start,another._start);
+            std::swap(_finish,another._finish);
+            std::swap(_end_of_storage,another._end_of_storage);
+            std::swap(_alloc,another._alloc);
+            return;
+        }
+        small_vector temp(std::move(another));
+        another = std::move(*this);
+        *this = std::move(temp);
+    }
+};
+
+// C++17 之前按引用使用 inline_capacity（如 std::max）需要类外定义
+template<class T, size_t N, class Alloc>
+constexpr typename small_vector<T,N,Alloc>::size_type small_vector<T,N,Alloc>::inline_capacity;
+
+} // namespace MySTL
+
+#endif // SMALL_VECTOR_H
@@ -0,0 +1,442 @@
+#ifndef SOA_VECTOR_H
+#define SOA_VECTOR_H
+
+// 这个文件是 soa_vector 的头文件
+// soa_vector<Ts...> 按列存放记录：每个成员各占一段连续的内存，而不是 vector<struct> 那样按行存放
+// 只扫描其中一两列时只读取需要的字节，每一列都可以取出 column_span 直接交给循环向量化
+// 迭代器把同一行的各列打包成 std::tuple<Ts&...>，可以用于只读取或逐行赋值的算法；
+// 这个引用不能交换，sort、heap、reverse 等需要交换元素的算法不能直接作用于它，应当先对行号排序再按排列重排各列
+// 各列的内存由 Alloc 按列的类型 rebind 后分配，soa_vector<Ts...> 使用 pool_allocator
+#include "pool_allocator.h"
+#include "uninitialized.h"
+#include "construct.h"
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace MySTL {
+
+// 编译期的下标序列，用于逐列展开
+template<size_t... I>
+struct _soa_indices {};
+
+template<size_t N, size_t... I>
+struct _soa_make_indices : _soa_make_indices<N - 1, N - 1, I...> {};
+
+template<size_t... I>
+struct _soa_make_indices<0, I...> { typedef _soa_indices<I...> type; };
+
+// 所有条件都为 true
+template<bool... B>
+struct _soa_bools {};
+
+template<bool... B>
+struct _soa_all : std::is_same< _soa_bools<true, B...>, _soa_bools<B..., true> > {};
+
+
+// 一列元素的视图，不拥有内存
+template<class T>
+class column_span{
+public:
+    typedef  T              value_type;
+    typedef  T*             iterator;
+    typedef  T*             pointer;
+    typedef  T&             reference;
+    typedef  size_t         size_type;
+
+    column_span(): _data(nullptr), _size(0) {}
+    column_span(T* data, size_type n): _data(data), _size(n) {}
+
+    pointer data() const { return _data; }
+    size_type size() const { return _size; }
+    bool empty() const { return 0 == _size; }
+    iterator begin() const { return _data; }
+    iterator end() const { return _data + _size; }
+    reference operator[](size_type n) const { return _data[n]; }
+
+private:
+    T*          _data;
+    size_type   _size;
+};
+
+
+// soa_vector 的迭代器，保存各列的起始地址和行号，解引用得到各列引用组成的 tuple
+// 解引用的结果是临时的 tuple，可以读取、比较和整体赋值，但不能 swap，也不能从中移动出 value_type
+template<bool Const, class... Ts>
+class _soa_iterator{
+    template<bool, class...> friend class _soa_iterator;
+
+public:
+    typedef  std::random_access_iterator_tag    iterator_category;
+    typedef  std::tuple<Ts...>                  value_type;
+    typedef  ptrdiff_t                          difference_type;
+    typedef  void                               pointer;
+    typedef  typename std::conditional<Const, std::tuple<const Ts&...>, std::tuple<Ts&...> >::type reference;
+    typedef  typename std::conditional<Const, std::tuple<const Ts*...>, std::tuple<Ts*...> >::type columns_type;
+
+private:
+    typedef typename _soa_make_indices<sizeof...(Ts)>::type indices;
+
+    columns_type        _columns;
+    difference_type     _index;
+
+    template<size_t... I>
+    reference deref(difference_type n, _soa_indices<I...>) const
+    { return reference( std::get<I>(_columns)[n]... ); }
+
+public:
+    _soa_iterator(): _columns(), _index(0) {}
+    _soa_iterator(const columns_type& columns, difference_type n): _columns(columns), _index(n) {}
+    // iterator 可以转换为 const_iterator
+    template<bool OtherConst, class = typename std::enable_if<Const && !OtherConst>::type>
+    _soa_iterator(const _soa_iterator<OtherConst, Ts...>& x): _columns(x._columns), _index(x._index) {}
+
+    // 当前行号
+    difference_type index() const { return _index; }
+
+    reference operator*() const { return deref(_index, indices()); }
+    reference operator[](difference_type n) const { return deref(_index + n, indices()); }
+
+    _soa_iterator& operator++() { ++_index; return *this; }
+    _soa_iterator  operator++(int) { _soa_iterator temp = *this; ++_index; return temp; }
+    _soa_iterator& operator--() { --_index; return *this; }
+    _soa_iterator  operator--(int) { _soa_iterator temp = *this; --_index; return temp; }
+    _soa_iterator& operator+=(difference_type n) { _index += n; return *this; }
+    _soa_iterator& operator-=(difference_type n) { _index -= n; return *this; }
+    _soa_iterator  operator+(difference_type n) const { return _soa_iterator(_columns, _index + n); }
+    _soa_iterator  operator-(difference_type n) const { return _soa_iterator(_columns, _index - n); }
+    difference_type operator-(const _soa_iterator& x) const { return _index - x._index; }
+
+    // 只比较行号，比较不同容器的迭代器没有意义
+    bool operator==(const _soa_iterator& x) const { return _index == x._index; }
+    bool operator!=(const _soa_iterator& x) const { return _index != x._index; }
+    bool operator<(const _soa_iterator& x) const { return _index < x._index; }
+    bool operator>(const _soa_iterator& x) const { return _index > x._index; }
+    bool operator<=(const _soa_iterator& x) const { return _index <= x._index; }
+    bool operator>=(const _soa_iterator& x) const { return _index >= x._index; }
+};
+
+template<bool Const, class... Ts>
+inline _soa_iterator<Const, Ts...> operator+(ptrdiff_t n, const _soa_iterator<Const, Ts...>& x) { return x + n; }
+
+
+template<class Alloc, class... Ts>
+class basic_soa_vector{
+
+public:
+    typedef  std::tuple<Ts...>                  value_type;
+    typedef  std::tuple<Ts&...>                 reference;
+    typedef  std::tuple<const Ts&...>           const_reference;
+    typedef  _soa_iterator<false, Ts...>        iterator;
+    typedef  _soa_iterator<true, Ts...>         const_iterator;
+    typedef  size_t                             size_type;
+    typedef  ptrdiff_t                          difference_type;
+    typedef  Alloc                              allocator_type;
+
+    // 第 I 列的元素类型
+    template<size_t I>
+    struct column_type { typedef typename std::tuple_element<I, value_type>::type type; };
+
+    static const size_type columns = sizeof...(Ts);
+
+private:
+    typedef typename _soa_make_indices<sizeof...(Ts)>::type indices;
+    typedef std::tuple<Ts*...> columns_type;
+
+    columns_type    _columns;       // 各列的起始地址，所有列的容量相同
+    size_type       _size;
+    size_type       _capacity;
+    Alloc           _alloc;         // 每一列用 rebind 到该列类型的副本分配
+
+    // 所有列的移动构造都不抛出异常时扩容才移动元素，否则全部拷贝，保证异常时旧空间不变
+    typedef std::integral_constant<bool,
+                _soa_all<std::is_nothrow_move_constructible<Ts>::value...>::value
+                || !_soa_all<std::is_copy_constructible<Ts>::value...>::value>  move_on_grow;
+
+    // 对每一列执行一次 f，按列的顺序
+    template<class F, size_t... I>
+    static void for_each_column(columns_type& columns, F f, _soa_indices<I...>)
+    {
+        int dummy[] = { 0, ( f(std::get<I>(columns)), 0 )... };
+        (void)dummy;
+    }
+
+    struct destory_rows{
+        size_type first, last;
+        template<class T> void operator()(T* column) const { destory(column + first, column + last); }
+    };
+    struct deallocate_column{
+        const Alloc& alloc;
+        size_type n;
+        template<class T> void operator()(T*& column) const
+        {
+            typename Alloc::template rebind<T>::other column_alloc(alloc);
+            if ( column ) column_alloc.deallocate(column, n);
+            column = nullptr;
+        }
+    };
+
+    // 把第 I 列之前（不含）已经放到新空间的各列析构掉
+    template<size_t I>
+    void destory_prefix(columns_type&, std::integral_constant<size_t, I>, std::integral_constant<size_t, I>) {}
+    template<size_t I, size_t J>
+    void destory_prefix(columns_type& new_columns, std::integral_constant<size_t, I>, std::integral_constant<size_t, J>)
+    {
+        destory(std::get<J>(new_columns), std::get<J>(new_columns) + _size);
+        destory_prefix(new_columns, std::integral_constant<size_t, I>(), std::integral_constant<size_t, J + 1>());
+    }
+
+    // 把一列元素搬到新空间：可以按字节搬移的直接 memcpy，否则移动或拷贝
+    template<class T>
+    static void relocate_column(T* first, T* last, T* result, std::true_type)
+    {
+        if ( is_trivially_relocatable<T>::value ){
+            if ( first != last )
+                std::memcpy(static_cast<void*>(result), static_cast<void*>(first), (last - first) * sizeof(T));
+        }
+        else
+            MySTL::uninitialized_move(first, last, result);
+    }
+    template<class T>
+    static void relocate_column(T* first, T* last, T* result, std::false_type)
+    { MySTL::uninitialized_copy(first, last, result); }
+    // 按字节搬走的列不再析构旧元素
+    template<class T>
+    static void destory_relocated(T* first, T* last)
+    {
+        if ( !(move_on_grow::value && is_trivially_relocatable<T>::value) )
+            destory(first, last);
+    }
+
+    template<size_t I>
+    void relocate_columns(columns_type&, std::integral_constant<size_t, I>, std::true_type) {}
+    template<size_t I>
+    void relocate_columns(columns_type& new_columns, std::integral_constant<size_t, I>, std::false_type)
+    {
+        try{
+            relocate_column(std::get<I>(_columns), std::get<I>(_columns) + _size, std::get<I>(new_columns), move_on_grow());
+        }
+        catch(...){
+            destory_prefix(new_columns, std::integral_constant<size_t, I>(), std::integral_constant<size_t, 0>());
+            throw;
+        }
+        relocate_columns(new_columns, std::integral_constant<size_t, I + 1>(),
+                         std::integral_constant<bool, I + 1 == sizeof...(Ts)>());
+    }
+
+    struct allocate_column{
+        const Alloc& alloc;
+        size_type n;
+        template<class T> void operator()(T*& column) const
+        {
+            typename Alloc::template rebind<T>::other column_alloc(alloc);
+            column = column_alloc.allocate(n);
+        }
+    };
+
+    // 所有列一起换到容量为 new_cap 的空间
+    void grow(size_type new_cap)
+    {
+        columns_type new_columns;
+        for_each_column(new_columns, set_null(), indices());
+        try{
+            for_each_column(new_columns, allocate_column{_alloc, new_cap}, indices());
+        }
+        catch(...){
+            for_each_column(new_columns, deallocate_column{_alloc, new_cap}, indices());
+            throw;
+        }
+        try{
+            relocate_columns(new_columns, std::integral_constant<size_t, 0>(),
+                             std::integral_constant<bool, 0 == sizeof...(Ts)>());
+        }
+        catch(...){
+            for_each_column(new_columns, deallocate_column{_alloc, new_cap}, indices());
+            throw;
+        }
+        destory_old_columns(indices());
+        for_each_column(_columns, deallocate_column{_alloc, _capacity}, indices());
+        _columns = new_columns;
+        _capacity = new_cap;
+    }
+    struct set_null{
+        template<class T> void operator()(T*& column) const { column = nullptr; }
+    };
+    template<size_t... I>
+    void destory_old_columns(_soa_indices<I...>)
+    {
+        int dummy[] = { 0, ( destory_relocated(std::get<I>(_columns), std::get<I>(_columns) + _size), 0 )... };
+        (void)dummy;
+    }
+
+    // 在第 pos 行逐列构造 args 中对应的元素，某一列抛出异常时析构已经构造的列
+    template<class Tuple>
+    void construct_row(size_type, Tuple&&, std::integral_constant<size_t, sizeof...(Ts)>) {}
+    template<class Tuple, size_t I>
+    void construct_row(size_type pos, Tuple&& args, std::integral_constant<size_t, I>)
+    {
+        construct(std::get<I>(_columns) + pos, std::get<I>(std::forward<Tuple>(args)));
+        try{
+            construct_row(pos, std::forward<Tuple>(args), std::integral_constant<size_t, I + 1>());
+        }
+        catch(...){
+            destory(std::get<I>(_columns) + pos);
+            throw;
+        }
+    }
+
+    template<class Tuple>
+    void append_row(Tuple&& args)
+    {
+        construct_row(_size, std::forward<Tuple>(args), std::integral_constant<size_t, 0>());
+        ++_size;
+    }
+
+    template<size_t... I>
+    reference row(size_type n, _soa_indices<I...>) { return reference( std::get<I>(_columns)[n]... ); }
+    template<size_t... I>
+    const_reference row(size_type n, _soa_indices<I...>) const { return const_reference( std::get<I>(_columns)[n]... ); }
+
+    // 把 columns_type 转为各列 const 指针组成的 tuple
+    template<size_t... I>
+    typename const_iterator::columns_type const_columns(_soa_indices<I...>) const
+    { return typename const_iterator::columns_type( std::get<I>(_columns)... ); }
+
+public:
+    basic_soa_vector(): _size(0), _capacity(0) { for_each_column(_columns, set_null(), indices()); }
+    explicit basic_soa_vector(const Alloc& a): _size(0), _capacity(0), _alloc(a)
+    { for_each_column(_columns, set_null(), indices()); }
+    explicit basic_soa_vector(size_type n, const Alloc& a = Alloc()): basic_soa_vector(a) { reserve(n); }
+    // 拷贝构造函数，容量与元素个数相同，分配器随之拷贝
+    basic_soa_vector(const basic_soa_vector& x): basic_soa_vector(x._alloc)
+    {
+        reserve(x._size);
+        for ( size_type i = 0; i != x._size; ++i )
+            append_row(x[i]);
+    }
+    basic_soa_vector(basic_soa_vector&& x) noexcept
+        : _columns(x._columns), _size(x._size), _capacity(x._capacity), _alloc(x._alloc)
+    {
+        for_each_column(x._columns, set_null(), indices());
+        x._size = x._capacity = 0;
+    }
+    ~basic_soa_vector()
+    {
+        clear();
+        for_each_column(_columns, deallocate_column{_alloc, _capacity}, indices());
+    }
+
+    basic_soa_vector& operator=(const basic_soa_vector& x)
+    {
+        if ( &x != this ){
+            basic_soa_vector temp(x);
+            swap(temp);
+        }
+        return *this;
+    }
+    basic_soa_vector& operator=(basic_soa_vector&& x) noexcept
+    {
+        if ( &x != this ){
+            basic_soa_vector temp(std::move(x));
+            swap(temp);
+        }
+        return *this;
+    }
+
+public:
+    allocator_type get_allocator() const { return _alloc; }
+
+    iterator begin() { return iterator(_columns, 0); }
+    iterator end() { return iterator(_columns, _size); }
+    const_iterator begin() const { return cbegin(); }
+    const_iterator end() const { return cend(); }
+    const_iterator cbegin() const { return const_iterator(const_columns(indices()), 0); }
+    const_iterator cend() const { return const_iterator(const_columns(indices()), _size); }
+
+    size_type size() const { return _size; }
+    size_type capacity() const { return _capacity; }
+    bool empty() const { return 0 == _size; }
+
+    // 第 n 行各列的引用
+    reference operator[](size_type n) { return row(n, indices()); }
+    const_reference operator[](size_type n) const { return row(n, indices()); }
+    reference front() { return (*this)[0]; }
+    reference back() { return (*this)[_size - 1]; }
+
+    // 第 I 列的起始地址和视图，扩容后失效
+    template<size_t I>
+    typename column_type<I>::type* data() { return std::get<I>(_columns); }
+    template<size_t I>
+    const typename column_type<I>::type* data() const { return std::get<I>(_columns); }
+    template<size_t I>
+    column_span<typename column_type<I>::type> column()
+    { return column_span<typename column_type<I>::type>(std::get<I>(_columns), _size); }
+    template<size_t I>
+    column_span<const typename column_type<I>::type> column() const
+    { return column_span<const typename column_type<I>::type>(std::get<I>(_columns), _size); }
+
+    // 插入末尾，tuple 中的每个成员放到对应的列
+    void push_back(const value_type& value) { emplace_back_tuple(value); }
+    void push_back(value_type&& value) { emplace_back_tuple(std::move(value)); }
+    // 每一列用对应的参数构造
+    template<class... Args>
+    void emplace_back(Args&&... args)
+    {
+        static_assert(sizeof...(Args) == sizeof...(Ts), "basic_soa_vector::emplace_back needs one argument per column");
+        emplace_back_tuple( std::forward_as_tuple(std::forward<Args>(args)...) );
+    }
+    void pop_back()
+    {
+        --_size;
+        for_each_column(_columns, destory_rows{_size, _size + 1}, indices());
+    }
+    void clear()
+    {
+        for_each_column(_columns, destory_rows{0, _size}, indices());
+        _size = 0;
+    }
+
+    // 所有列一起预留 new_cap 行的空间
+    // 每一行总是占满所有列，各列的容量保持一致，不提供单独某一列的预留
+    void reserve(size_type new_cap)
+    {
+        if ( new_cap > _capacity )
+            grow(new_cap);
+    }
+
+    void swap(basic_soa_vector& another)
+    {
+        std::swap(_columns, another._columns);
+        std::swap(_size, another._size);
+        std::swap(_capacity, another._capacity);
+        std::swap(_alloc, another._alloc);
+    }
+
+private:
+    template<class Tuple>
+    void emplace_back_tuple(Tuple&& args)
+    {
+        if ( _size == _capacity ){
+            // args 可能引用容器中的元素，先构造出新值再扩容
+            value_type value_copy(std::forward<Tuple>(args));
+            grow(0 == _capacity ? 1 : 2 * _capacity);
+            append_row(std::move(value_copy));
+        }
+        else
+            append_row(std::forward<Tuple>(args));
+    }
+};
+
+template<class Alloc, class... Ts>
+const typename basic_soa_vector<Alloc, Ts...>::size_type basic_soa_vector<Alloc, Ts...>::columns;
+
+// 使用内存池的 soa_vector，各列由 pool_allocator rebind 得到
+template<class... Ts>
+using soa_vector = basic_soa_vector<pool_allocator<char>, Ts...>;
+
+} // namespace MySTL
+
+#endif // SOA_VECTOR_H
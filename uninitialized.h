@@ -1,26 +1,36 @@
 #ifndef UNINITIALIZED_H
 #define UNINITIALIZED_H
 
-// 这个文件包含三个全局函数
+// 这个文件包含以下全局函数
 // uninitialized_copy
+// uninitialized_move
+// uninitialized_move_if_noexcept
 // uninitialized_fill
 // uninitialized_fill_n
+// uninitialized_default_n
+// 以及类型特性 is_trivially_relocatable
 
 #include <iterator>
 #include <type_traits>
 #include "construct.h"
+#include "algobase.h"
 
 namespace MySTL{
 
-// pod 版本就调用这个版本
+// 对象可以用 memcpy 搬到新地址，并且不需要在旧地址析构
+// 默认为可平凡拷贝的类型；其他满足条件的类型（例如只持有 unique_ptr 的类）可以特化为 true_type
+template <class T>
+struct is_trivially_relocatable : std::integral_constant<bool, std::is_trivially_copyable<T>::value> {};
+
+// 源与目标是同一种可平凡拷贝的类型时调用这个版本，原生指针由 MySTL::copy 转为 memmove
 template<class InputIterator,class ForwardIterator>
 inline ForwardIterator
 __uninitialized_copy(InputIterator first,InputIterator last, ForwardIterator result, std::true_type)
 {
-    return std::copy(first,last,result);
+    return MySTL::copy(first,last,result);
 }
 
-// 不是 pod 类型将调用这个版本
+// 其他情况逐个构造，例如由 const char* 构造 std::string
 template<class InputIterator,class ForwardIterator>
 inline ForwardIterator
 __uninitialized_copy(InputIterator first,InputIterator last, ForwardIterator result, std::false_type)
@@ -33,6 +43,7 @@ __uninitialized_copy(InputIterator first,InputIterator last, ForwardIterator res
     catch(...){
         for (; result != cur; ++result)
             destory(&*result);
+        throw;
     }
     return cur;
 }
@@ -42,8 +53,46 @@ __uninitialized_copy(InputIterator first,InputIterator last, ForwardIterator res
 template<class InputIterator,class ForwardIterator>
 inline ForwardIterator uninitialized_copy(InputIterator first, InputIterator last, ForwardIterator result)
 {
+    typedef typename std::iterator_traits<InputIterator>::value_type   src_type;
+    typedef typename std::iterator_traits<ForwardIterator>::value_type dst_type;
+    // 目标是未构造的内存，只有类型相同且构造等价于赋值时才能直接赋值
     return __uninitialized_copy(first,last,result,
-                                std::is_pod<typename std::iterator_traits<InputIterator>::value_type>() );
+                                std::integral_constant<bool,
+                                    std::is_same<typename std::remove_cv<src_type>::type, dst_type>::value
+                                    && std::is_trivially_copyable<dst_type>::value
+                                    && std::is_trivially_copy_assignable<dst_type>::value>() );
+}
+
+// 函数 uninitialized_move 将 first 与 last 之间的元素移动到 result 的空间中，原元素仍需析构
+template<class InputIterator,class ForwardIterator>
+inline ForwardIterator uninitialized_move(InputIterator first, InputIterator last, ForwardIterator result)
+{
+    return MySTL::uninitialized_copy(std::make_move_iterator(first), std::make_move_iterator(last), result);
+}
+
+// 移动构造不会抛出异常，或者元素不能拷贝时移动，否则拷贝
+// 供重新分配时使用：中途出现异常时原来的元素保持不变
+template<class InputIterator,class ForwardIterator>
+inline ForwardIterator
+__uninitialized_move_if_noexcept(InputIterator first, InputIterator last, ForwardIterator result, std::true_type)
+{
+    return MySTL::uninitialized_move(first,last,result);
+}
+
+template<class InputIterator,class ForwardIterator>
+inline ForwardIterator
+__uninitialized_move_if_noexcept(InputIterator first, InputIterator last, ForwardIterator result, std::false_type)
+{
+    return MySTL::uninitialized_copy(first,last,result);
+}
+
+template<class InputIterator,class ForwardIterator>
+inline ForwardIterator uninitialized_move_if_noexcept(InputIterator first, InputIterator last, ForwardIterator result)
+{
+    using T = typename std::iterator_traits<InputIterator>::value_type;
+    return __uninitialized_move_if_noexcept(first,last,result,
+        std::integral_constant<bool, std::is_nothrow_move_constructible<T>::value
+                                     || !std::is_copy_constructible<T>::value>() );
 }
 
 
@@ -67,7 +116,8 @@ __uninitialized_fill(ForwardIterator first, ForwardIterator last, T value, std::
     }
     catch(...){
         for (; first != cur; ++first)
-            destory(&*cur);
+            destory(&*first);
+        throw;
     }
 
 }
@@ -104,6 +154,7 @@ __uninitialized_fill_n(ForwardIterator result,Size n, T value, std::false_type)
     catch(...){
         for (; result != cur; ++result)
             destory(&*result);
+        throw;
     }
     return cur;
 }
@@ -118,6 +169,44 @@ uninitialized_fill_n(ForwardIterator result,Size n, T value)
                                   std::is_pod<typename std::iterator_traits<ForwardIterator>::value_type>() );
 }
 
+// 平凡默认构造的类型什么都不做，内存保持原样，不会被写入
+template<class ForwardIterator,class Size>
+inline ForwardIterator
+__uninitialized_default_n(ForwardIterator result,Size n, std::true_type)
+{
+    std::advance(result,n);
+    return result;
+}
+
+// 其他类型逐个默认构造
+template<class ForwardIterator,class Size>
+inline ForwardIterator
+__uninitialized_default_n(ForwardIterator result,Size n, std::false_type)
+{
+    typedef typename std::iterator_traits<ForwardIterator>::value_type value_type;
+    ForwardIterator cur = result;
+    try{
+        for ( ; n > 0; --n,++cur)
+            ::new (static_cast<void*>(&*cur)) value_type;
+    }
+    catch(...){
+        for (; result != cur; ++result)
+            destory(&*result);
+        throw;
+    }
+    return cur;
+}
+
+// 函数 uninitialized_default_n 对 result 开始的 n 个空间做默认初始化（不是值初始化）
+// int、double 这类类型的值不确定，空间中的内存不会被访问
+template<class ForwardIterator,class Size>
+inline ForwardIterator
+uninitialized_default_n(ForwardIterator result,Size n)
+{
+    return __uninitialized_default_n(result,n,
+               std::is_trivially_default_constructible<typename std::iterator_traits<ForwardIterator>::value_type>() );
+}
+
 
 
 } // namespace MySTL
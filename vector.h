@@ -5,12 +5,37 @@
 #include "pool_allocator.h"
 #include "uninitialized.h"
 #include "construct.h"
+#include "algobase.h"
 #include <cstddef>
 #include <initializer_list>
+#include <utility>
+#include <cstring>
+#include <iterator>
 
 namespace MySTL {
 
-template<class T,class Alloc = pool_allocator<T> >
+// vector 的增长策略：给出当前容量和至少需要的容量，返回扩容后的容量
+// 结果还会再向上取到分配器实际给出的大小，见 vector::next_capacity()
+// 按 Num/Den 倍增长，至少增长一个元素
+template<size_t Num, size_t Den>
+struct geometric_growth{
+    static size_t next_capacity(size_t capacity, size_t required)
+    {
+        size_t len = capacity / Den * Num + capacity % Den * Num / Den;
+        if ( len <= capacity )
+            len = capacity + 1;
+        return len < required ? required : len;
+    }
+};
+typedef geometric_growth<2,1>   double_growth;      // 2 倍，默认策略
+typedef geometric_growth<3,2>   half_growth;        // 1.5 倍，释放的旧空间有机会被后面的扩容复用
+
+// 只扩到恰好需要的大小，适合大小基本确定、只偶尔追加的场合
+struct exact_growth{
+    static size_t next_capacity(size_t, size_t required) { return required; }
+};
+
+template<class T,class Alloc = pool_allocator<T>, class Growth = double_growth >
 class vector{
 
 public:
@@ -23,63 +48,148 @@ public:
     typedef  const T&       const_reference;
     typedef  size_t         size_type;
     typedef  ptrdiff_t      difference_type;
+    typedef  Alloc          allocator_type;
+    typedef  Growth         growth_policy;
 
 private:
     pointer _start;
     pointer _finish;
     pointer _end_of_storage;
+    Alloc   _alloc;         // 分配器对象，有状态的分配器（如 polymorphic_allocator）保存在这里
 
 private:
     void fill_initialize(size_type n,const_reference value);
-    void deallocate() { if (_start) Alloc::deallocate(_start, _end_of_storage - _start); }
+    void deallocate() { if (_start) _alloc.deallocate(_start, _end_of_storage - _start); }
     iterator allocate_and_fill(size_type n, const_reference value );
-    void insert_aux(iterator position,const_reference value);
+    // 在 position 处用 args 构造一个元素，空间不足时重新分配
+    template <class... Args>
+    void insert_aux(iterator position, Args&&... args);
+
+    // 再放 n 个元素时的新容量：先按增长策略计算，再取到分配器实际给出的大小
+    // pool_allocator 按级别分配，多出的几个元素不占额外的内存
+    size_type next_capacity(size_type n) const
+    { return allocator_usable_size(_alloc, Growth::next_capacity(capacity(), size() + n)); }
+
+    // 可以按字节搬移、并且移动不抛出异常的元素，扩容时交给分配器的 reallocate
+    // 大块内存可以原地扩展，否则一次 memcpy，不逐个调用构造和析构函数
+    static bool relocatable()
+    {
+        return is_trivially_relocatable<T>::value && std::is_nothrow_move_constructible<T>::value;
+    }
+    void relocate_storage(size_type new_cap)
+    {
+        size_type old_size = size();
+        _start = allocator_reallocate(_alloc, _start, capacity(), new_cap);
+        _finish = _start + old_size;
+        _end_of_storage = _start + new_cap;
+    }
+    // 在 position 处空出 n 个未构造的位置，后面的元素按字节后移，空间必须足够
+    iterator open_gap(iterator position, size_type n)
+    {
+        if ( position != _finish )
+            std::memmove(static_cast<void*>(position + n), static_cast<void*>(position),
+                         (_finish - position) * sizeof(T));
+        return position;
+    }
+
+    // 前向迭代器先算出元素个数，一次分配后整体拷贝；输入迭代器只能逐个追加
+    template<class InputIterator>
+    void range_initialize(InputIterator first, InputIterator last, std::input_iterator_tag)
+    {
+        for ( ; first != last; ++first )
+            emplace_back(*first);
+    }
+    template<class ForwardIterator>
+    void range_initialize(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+    {
+        size_type n = static_cast<size_type>( std::distance(first,last) );
+        _start = _alloc.allocate(n);
+        try{
+            _finish = MySTL::uninitialized_copy(first,last,_start);
+        }
+        catch(...){
+            _alloc.deallocate(_start,n);
+            throw;
+        }
+        _end_of_storage = _start + n;
+    }
+
+    template<class InputIterator>
+    void range_insert(iterator position, InputIterator first, InputIterator last, std::input_iterator_tag);
+    template<class ForwardIterator>
+    void range_insert(iterator position, ForwardIterator first, ForwardIterator last, std::forward_iterator_tag);
+
+    template<class InputIterator>
+    void range_assign(InputIterator first, InputIterator last, std::input_iterator_tag)
+    {
+        clear();
+        for ( ; first != last; ++first )
+            emplace_back(*first);
+    }
+    template<class ForwardIterator>
+    void range_assign(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag);
 public:
     vector(): _start(nullptr), _finish(nullptr), _end_of_storage(nullptr) {}
-    vector(size_type n,const value_type& value) {  fill_initialize(n,value); }
-    explicit vector(size_type n) { fill_initialize(n,T()); }
-    // 拷贝构造函数
-    vector(const vector & x)
+    explicit vector(const Alloc& a): _start(nullptr), _finish(nullptr), _end_of_storage(nullptr), _alloc(a) {}
+    vector(size_type n,const value_type& value, const Alloc& a = Alloc()): _alloc(a) {  fill_initialize(n,value); }
+    explicit vector(size_type n, const Alloc& a = Alloc()): _alloc(a) { fill_initialize(n,T()); }
+    // 拷贝构造函数，分配器随之拷贝
+    vector(const vector & x): _alloc(x._alloc)
     {
-        pointer p = Alloc::allocate(x.size());
-        uninitialized_copy( x.cbegin(),x.cend(),p);
+        pointer p = _alloc.allocate(x.size());
+        MySTL::uninitialized_copy( x.cbegin(),x.cend(),p);
         _start = p;
         _end_of_storage = _finish = _start + x.size();
     }
+    // 移动构造函数，直接接管 x 的内存
+    vector(vector&& x) noexcept
+        : _start(x._start), _finish(x._finish), _end_of_storage(x._end_of_storage), _alloc(std::move(x._alloc))
+    {
+        x._start = x._finish = x._end_of_storage = nullptr;
+    }
     // 拷贝赋值
-    vector& operator=(vector& x)
+    vector& operator=(const vector& x)
     {
-        reserve(x.size());
-        uninitialized_copy(x.begin(),x.end(),begin());
-        _start;
-        _end_of_storage = _finish = _start + x.size();
+        if ( &x != this ){
+            vector temp(x);
+            swap(temp);
+        }
+        return *this;
     }
-
-    template<class InputIterator>
-    vector(InputIterator first,InputIterator last)
+    // 移动赋值，释放自己的元素后接管 x 的内存
+    vector& operator=(vector&& x) noexcept
     {
-        size_type num = 0;
-        for (InputIterator temp = first; temp != last; ++temp)
-            ++num;
+        if ( &x != this ){
+            destory(_start,_finish);
+            deallocate();
+            _start = x._start;
+            _finish = x._finish;
+            _end_of_storage = x._end_of_storage;
+            _alloc = std::move(x._alloc);
+            x._start = x._finish = x._end_of_storage = nullptr;
+        }
+        return *this;
+    }
 
-        _start = Alloc::allocate(num);
-        _end_of_storage = _finish = _start + num;
-        uninitialized_copy(first,last,_start);
+    // 只接受迭代器，vector<int>(5, 1) 这样的调用会选择 (n, value) 的构造函数
+    template<class InputIterator, class = typename std::iterator_traits<InputIterator>::iterator_category>
+    vector(InputIterator first,InputIterator last, const Alloc& a = Alloc())
+        : _start(nullptr), _finish(nullptr), _end_of_storage(nullptr), _alloc(a)
+    {
+        range_initialize(first,last,typename std::iterator_traits<InputIterator>::iterator_category());
     }
 
 
-    vector(const std::initializer_list<value_type>& list ) {
-        _start = Alloc::allocate(list.size());
-        _finish = _start + list.size();
-        pointer cur = _start;
-        for (auto item = list.begin(); item != list.end(); ++item)
-            Alloc::construct(cur++,*item);
-        _end_of_storage = _finish;
+    vector(const std::initializer_list<value_type>& list, const Alloc& a = Alloc() )
+        : _start(nullptr), _finish(nullptr), _end_of_storage(nullptr), _alloc(a)
+    {
+        range_initialize(list.begin(),list.end(),std::random_access_iterator_tag());
     }
 
     ~vector() { destory(_start,_finish); deallocate(); }
 
 public:
+    allocator_type get_allocator() const { return _alloc; }
     iterator begin()  {return _start; }
     const_iterator cbegin() const { return _start; }
     const_iterator cend() const { return _finish; }
@@ -94,7 +204,61 @@ public:
 
     // 插入末尾
     void push_back(const_reference value);
+    void push_back(value_type&& value) { emplace_back(std::move(value)); }
+    // 在末尾直接用 args 构造元素
+    template <class... Args>
+    reference emplace_back(Args&&... args)
+    {
+        if ( _finish != _end_of_storage ){
+            construct(_finish, std::forward<Args>(args)...);
+            ++_finish;
+        }
+        else
+            insert_aux(_finish, std::forward<Args>(args)...);
+        return back();
+    }
+    // 在 position 处直接用 args 构造元素，返回指向新元素的迭代器
+    template <class... Args>
+    iterator emplace(iterator position, Args&&... args)
+    {
+        size_type offset = position - _start;
+        insert_aux(position, std::forward<Args>(args)...);
+        return _start + offset;
+    }
     void insert(iterator position,size_type n, value_type value);
+    // 在 position 处插入区间中的元素，最终大小只计算一次，空间不足时只扩容一次
+    // 返回指向第一个插入元素的迭代器
+    template<class InputIterator, class = typename std::iterator_traits<InputIterator>::iterator_category>
+    iterator insert(iterator position, InputIterator first, InputIterator last)
+    {
+        size_type offset = position - _start;
+        range_insert(position,first,last,typename std::iterator_traits<InputIterator>::iterator_category());
+        return _start + offset;
+    }
+    iterator insert(iterator position, std::initializer_list<value_type> list)
+    { return insert(position,list.begin(),list.end()); }
+    // 把区间中的元素追加到末尾
+    template<class InputIterator, class = typename std::iterator_traits<InputIterator>::iterator_category>
+    void append(InputIterator first, InputIterator last) { insert(end(),first,last); }
+    void append(std::initializer_list<value_type> list) { insert(end(),list.begin(),list.end()); }
+    // 用区间中的元素替换全部内容，容量足够时不重新分配
+    template<class InputIterator, class = typename std::iterator_traits<InputIterator>::iterator_category>
+    void assign(InputIterator first, InputIterator last)
+    { range_assign(first,last,typename std::iterator_traits<InputIterator>::iterator_category()); }
+    void assign(std::initializer_list<value_type> list) { assign(list.begin(),list.end()); }
+    void assign(size_type n, const value_type& value)
+    {
+        if ( n > capacity() ){
+            vector temp(n,value,_alloc);
+            swap(temp);
+        }
+        else if ( n > size() ){
+            std::fill(_start,_finish,value);
+            _finish = MySTL::uninitialized_fill_n(_finish,n - size(),value);
+        }
+        else
+            erase(std::fill_n(_start,n,value),_finish);
+    }
     void clear() { erase(_start,_finish); }
 
     // 弹出末尾
@@ -103,15 +267,15 @@ public:
     // 擦除 position 位置的值
     iterator erase(iterator position){
         if ( position != _finish -1 )
-            std::copy(position+1,_finish,position);
-        destory(_finish);
+            std::move(position+1,_finish,position);
         --_finish;
+        destory(_finish);
         return position;
     }
 
     iterator erase(iterator first,iterator last)
     {
-        iterator i = std::copy(last,_finish,first);
+        iterator i = std::move(last,_finish,first);
         destory(i,_finish);
         _finish = _finish-(last-first);
         return first;
@@ -119,7 +283,7 @@ public:
 
     void resize(size_type n)
     {
-        resize(n,size_type());
+        resize(n,value_type());
     }
     void resize(size_type n, const_reference value)
     {
@@ -129,14 +293,39 @@ public:
             _finish = _start+n;
         }
         else
-            insert( _finish,n,value);
+            insert( _finish,n - size(),value);
     }
+    // 与 resize 相同，但新增的元素只做默认初始化：int、double 这类类型不写入任何值
+    // 用于马上就会被 I/O 或计算整体覆盖的大缓冲区，省去一遍清零，页面到第一次真正写入时才分配
+    void resize_for_overwrite(size_type n)
+    {
+        if ( n <= size() ){
+            destory(_start+n,_finish);
+            _finish = _start+n;
+            return;
+        }
+        if ( n > capacity() )
+            reserve( Growth::next_capacity(capacity(), n) );
+        _finish = MySTL::uninitialized_default_n(_finish,n - size());
+    }
+    // 容量至少为 new_cap，分配器给出的余量一并计入容量
     void reserve(size_type new_cap)
     {
-        if ( new_cap > capacity() ){
-            pointer new_start = Alloc::allocate(new_cap);
+        if ( new_cap <= capacity() )
+            return;
+        new_cap = allocator_usable_size(_alloc, new_cap);
+        if ( relocatable() )
+            relocate_storage(new_cap);
+        else{
+            pointer new_start = _alloc.allocate(new_cap);
             pointer new_finish;
-            new_finish = MySTL::uninitialized_copy(_start,_finish,new_start);
+            try{
+                new_finish = MySTL::uninitialized_move_if_noexcept(_start,_finish,new_start);
+            }
+            catch(...){
+                _alloc.deallocate(new_start,new_cap);
+                throw;
+            }
             destory(_start,_finish);
             deallocate();
             _start = new_start;
@@ -147,32 +336,34 @@ public:
 
     void swap(vector& another)
     {
-        if ( &another != this)
-        std::swap(_start,another._start);
-        std::swap(_finish,another._finish);
-        std::swap(_end_of_storage,another._end_of_storage);
+        if ( &another != this){
+            std::swap(_start,another._start);
+            std::swap(_finish,another._finish);
+            std::swap(_end_of_storage,another._end_of_storage);
+            std::swap(_alloc,another._alloc);
+        }
     }
 
 };
 
-template<class T,class Alloc>
-void vector<T,Alloc>::fill_initialize(size_type n,  const_reference value)
+template<class T,class Alloc,class Growth>
+void vector<T,Alloc,Growth>::fill_initialize(size_type n,  const_reference value)
 {
     _start = allocate_and_fill(n,value);
     _finish = _start + n;
     _end_of_storage = _finish;
 }
 
-template<class T,class Alloc>
-typename vector<T,Alloc>::iterator vector<T,Alloc>::allocate_and_fill(size_type n, const_reference value )
+template<class T,class Alloc,class Growth>
+typename vector<T,Alloc,Growth>::iterator vector<T,Alloc,Growth>::allocate_and_fill(size_type n, const_reference value )
 {
-    pointer result = Alloc::allocate(n);
+    pointer result = _alloc.allocate(n);
     MySTL::uninitialized_fill_n(result,n,value);
     return result;
 }
 
-template<class T,class Alloc>
-void vector<T,Alloc>::push_back(const_reference value)
+template<class T,class Alloc,class Growth>
+void vector<T,Alloc,Growth>::push_back(const_reference value)
 {
     if ( _finish != _end_of_storage )
     {
@@ -183,30 +374,60 @@ void vector<T,Alloc>::push_back(const_reference value)
         insert_aux(_finish,value);
 }
 
-template<class T,class Alloc>
-void vector<T,Alloc>::insert_aux(iterator position,const_reference value)
+template<class T,class Alloc,class Growth>
+template<class... Args>
+void vector<T,Alloc,Growth>::insert_aux(iterator position, Args&&... args)
 {
-    if ( (_end_of_storage - _finish) ){
+    if ( _finish != _end_of_storage ){
+        if ( position == _finish ){
+            construct(_finish, std::forward<Args>(args)...);
+            ++_finish;
+            return;
+        }
+        // args 可能引用容器中的元素，先构造出新值再挪动
+        value_type value_copy(std::forward<Args>(args)...);
+        construct(_finish, std::move(*(_finish - 1)));
         ++_finish;
-        // copy_backward 从尾部开始拷贝，尾部一一对应
-        auto value_copy = value;
-        std::copy_backward(position,_finish - 2,_finish - 1);
-        *position = value_copy;
+        // move_backward 从尾部开始移动，尾部一一对应
+        std::move_backward(position,_finish - 2,_finish - 1);
+        *position = std::move(value_copy);
     }
     else{
-        const size_type old_size = size();
-        const size_type len = size() == 0? 1 : 2 * old_size ;
-        iterator new_start = Alloc::allocate(len);
+        const size_type len = next_capacity(1);
+        if ( relocatable() ){
+            // 先构造出新值，args 可能引用旧空间中的元素
+            value_type value_copy(std::forward<Args>(args)...);
+            size_type offset = position - _start;
+            relocate_storage(len);
+            position = open_gap(_start + offset, 1);
+            construct(position, std::move(value_copy));
+            ++_finish;
+            return;
+        }
+        iterator new_start = _alloc.allocate(len);
+        iterator new_position = new_start + (position - _start);
         iterator new_finish = new_start;
+        // 先构造新元素，因为 args 可能引用旧空间中的元素
+        // 旧元素的移动构造不会抛出异常时移动过去，否则拷贝，保证异常时旧空间不变
         try{
-            new_finish = uninitialized_copy(_start,position,new_start);
-            construct(new_finish,value);
+            construct(new_position, std::forward<Args>(args)...);
+        }
+        catch(...){
+            _alloc.deallocate(new_start,len);
+            throw;
+        }
+        try{
+            new_finish = MySTL::uninitialized_move_if_noexcept(_start,position,new_start);
             ++new_finish;
-            new_finish = uninitialized_copy(position,_finish,new_finish);
+            new_finish = MySTL::uninitialized_move_if_noexcept(position,_finish,new_finish);
         }
         catch(...){
-            destory(new_start,new_finish);
-            Alloc::deallocate(new_start,len);
+            if ( new_finish == new_start )
+                destory(new_position);
+            else
+                destory(new_start,new_finish);
+            _alloc.deallocate(new_start,len);
+            throw;
         }
 
         destory(_start,_finish);
@@ -219,44 +440,144 @@ void vector<T,Alloc>::insert_aux(iterator position,const_reference value)
 
 }
 
-template<class T,class Alloc>
-void vector<T,Alloc>::insert(iterator position,size_type n, value_type value)
+template<class T,class Alloc,class Growth>
+template<class InputIterator>
+void vector<T,Alloc,Growth>::range_insert(iterator position, InputIterator first, InputIterator last, std::input_iterator_tag)
+{
+    if ( position == _finish ){
+        for ( ; first != last; ++first )
+            emplace_back(*first);
+    }
+    else{
+        // 不知道元素个数，先收集到临时的 vector 中，再按前向迭代器插入
+        vector temp(first,last,_alloc);
+        range_insert(position,std::make_move_iterator(temp.begin()),std::make_move_iterator(temp.end()),
+                     std::random_access_iterator_tag());
+    }
+}
+
+template<class T,class Alloc,class Growth>
+template<class ForwardIterator>
+void vector<T,Alloc,Growth>::range_insert(iterator position, ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+{
+    if ( first == last )
+        return;
+    const size_type n = static_cast<size_type>( std::distance(first,last) );
+    if ( static_cast<size_type>(_end_of_storage - _finish) >= n ){
+        // 空间足够，与 insert(position, n, value) 相同的三段式搬移
+        const size_type elems_after = static_cast<size_type>(_finish - position);
+        iterator old_finish = _finish;
+        if ( elems_after > n ){
+            MySTL::uninitialized_move(_finish - n,_finish,_finish);
+            _finish += n;
+            std::move_backward(position,old_finish - n,old_finish);
+            MySTL::copy(first,last,position);
+        }
+        else{
+            ForwardIterator mid = first;
+            std::advance(mid,elems_after);
+            MySTL::uninitialized_copy(mid,last,_finish);
+            _finish += n - elems_after;
+            MySTL::uninitialized_move(position,old_finish,_finish);
+            _finish += elems_after;
+            MySTL::copy(first,mid,position);
+        }
+        return;
+    }
+
+    const size_type len = next_capacity(n);
+    if ( relocatable()
+         && std::is_nothrow_constructible<T, typename std::iterator_traits<ForwardIterator>::reference>::value ){
+        size_type offset = position - _start;
+        relocate_storage(len);
+        position = open_gap(_start + offset,n);
+        MySTL::uninitialized_copy(first,last,position);
+        _finish += n;
+        return;
+    }
+    pointer new_start = _alloc.allocate(len);
+    pointer new_finish = new_start;
+    try{
+        new_finish = MySTL::uninitialized_move_if_noexcept(_start,position,new_start);
+        new_finish = MySTL::uninitialized_copy(first,last,new_finish);
+        new_finish = MySTL::uninitialized_move_if_noexcept(position,_finish,new_finish);
+    }
+    catch(...){
+        destory(new_start,new_finish);
+        _alloc.deallocate(new_start,len);
+        throw;
+    }
+    destory(_start,_finish);
+    deallocate();
+    _start = new_start;
+    _finish = new_finish;
+    _end_of_storage = new_start + len;
+}
+
+template<class T,class Alloc,class Growth>
+template<class ForwardIterator>
+void vector<T,Alloc,Growth>::range_assign(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag)
+{
+    const size_type n = static_cast<size_type>( std::distance(first,last) );
+    if ( n > capacity() ){
+        vector temp(first,last,_alloc);
+        swap(temp);
+    }
+    else if ( n > size() ){
+        ForwardIterator mid = first;
+        std::advance(mid,size());
+        MySTL::copy(first,mid,_start);
+        _finish = MySTL::uninitialized_copy(mid,last,_finish);
+    }
+    else
+        erase(MySTL::copy(first,last,_start),_finish);
+}
+
+template<class T,class Alloc,class Growth>
+void vector<T,Alloc,Growth>::insert(iterator position,size_type n, value_type value)
 {
     if ( n != 0 ){
         // 总的空间足够
-        if ( _end_of_storage-_finish > n ){
+        if ( static_cast<size_type>(_end_of_storage - _finish) >= n ){
             size_type num = static_cast<size_type>(_finish - position);
-            //auto old_finish = _finish;
-            value_type value_copy = value;
+            pointer old_finish = _finish;
             if (num > n){
-                MySTL::uninitialized_copy(_finish-n,_finish,_finish);
-                std::copy_backward(position,_finish-n,_finish);
-                std::fill(position,position+n,value);
+                MySTL::uninitialized_move(_finish-n,_finish,_finish);
                 _finish += n;
+                std::move_backward(position,old_finish-n,old_finish);
+                MySTL::fill(position,position+n,value);
             }
             else{
-                MySTL::uninitialized_copy(position,_finish,_finish+n-num);
+                // [position, old_finish) 中的元素仍然存在，先搬到尾部，再对原位置赋值
                 MySTL::uninitialized_fill(_finish,_finish+n-num,value);
-                MySTL::uninitialized_fill(position,_finish,value);
-                _finish += n;
+                _finish += n-num;
+                MySTL::uninitialized_move(position,old_finish,_finish);
+                _finish += num;
+                MySTL::fill(position,old_finish,value);
             }
         }
         // 总的空间不足
         else{
-            const size_type old_size = size();
-            // len 为旧长度的2倍，或者是旧长度加上n
-            const size_type len = old_size + std::max(old_size,n);
-            pointer new_start = Alloc::allocate(len);
-            pointer new_finish;
+            const size_type len = next_capacity(n);
+            if ( relocatable() && std::is_nothrow_copy_constructible<T>::value ){
+                size_type offset = position - _start;
+                relocate_storage(len);
+                position = open_gap(_start + offset, n);
+                MySTL::uninitialized_fill_n(position,n,value);
+                _finish += n;
+                return;
+            }
+            pointer new_start = _alloc.allocate(len);
+            pointer new_finish = new_start;
             try{
-                new_finish = MySTL::uninitialized_copy(_start,position,new_start);
+                new_finish = MySTL::uninitialized_move_if_noexcept(_start,position,new_start);
                 MySTL::uninitialized_fill_n(new_finish,n,value);
                 new_finish += n;
-                MySTL::uninitialized_copy(position, _finish, new_finish);
+                new_finish = MySTL::uninitialized_move_if_noexcept(position, _finish, new_finish);
             }
             catch(...){
                 destory(new_start,new_finish);
-                Alloc::deallocate(new_start,len);
+                _alloc.deallocate(new_start,len);
                 throw;
             }
             destory(_start,_finish);